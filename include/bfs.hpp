@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <csr_graph.hpp>
+#include <flat_tree.hpp>
+#include <level_aggregate.hpp>
+
+// Streams a tree.json file through a SAX parser straight into the level-ordered arrays.
+// Throws std::runtime_error on malformed input.
+flat_tree load_tree(std::string const & path);
+
+// Per-level aggregate of a tree, every level is a contiguous range reduced on the persistent pool
+void bfs(flat_tree const & tree, std::size_t n_workers, aggregate const & agg);
+
+// Per-level aggregate of a graph, levels come from the frontier engine starting at source
+void bfs(csr_graph const & graph, std::uint32_t source, std::size_t n_workers, aggregate const & agg);
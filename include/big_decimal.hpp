@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <gmpxx.h>
+
+#include <thread_pool.hpp>
+
+// Numbers are cut down to pieces of about this many digits before mpz_get_str takes over
+constexpr std::size_t min_leaf_digits = 1 << 15;
+
+// Divide-and-conquer radix conversion: x is split by 10^(L * 2^j) into halves, level by level, with
+// every division of a level running as its own pool task; the leaves are converted in parallel
+// straight into their zero-padded slots of the result. The powers are squared with
+// parallel_multiply. Small numbers or single-thread pools fall back to a plain get_str().
+std::string to_decimal(thread_pool & pool, mpz_class const & x);
@@ -1,4 +1,45 @@
+#pragma once
+
 #include <cstdint>
-#include <vector>
+#include <span>
+#include <string_view>
+
+enum class cannon_shift
+{
+    reference, // rotate matrix rows and columns in place, as in the textbook algorithm
+    tiles,     // keep the operands in place and rotate a grid of tile pointers
+};
+
+inline std::string_view cannon_shift_name(cannon_shift shift)
+{
+    return shift == cannon_shift::reference ? "reference" : "tiles";
+}
+
+// Workers are laid out as a rows x cols grid, each one owning a rectangle of C tiles
+struct cannon_grid
+{
+    std::size_t rows;
+    std::size_t cols;
+};
+
+// The most square rows x cols factorisation of n_workers (rows <= cols)
+cannon_grid make_cannon_grid(std::size_t n_workers);
+
+// block_size as cannon_multiply resolves it for an N x N product of elem_size elements: 0 picks a size
+// that fits the L2 cache, and it never exceeds N
+std::size_t cannon_block_size(std::size_t N, std::size_t elem_size, std::size_t block_size, std::size_t n_workers);
 
-std::vector<int> cannon_matmul(std::size_t N, std::size_t n_workers);
+// C = A * B for row-major N x N matrices split into block_size x block_size tiles; any N works,
+// the last row and column of tiles are just narrower. block_size = 0 picks a size that fits the L2 cache.
+// A and B are only read (the reference schedule works on padded private copies), C is overwritten.
+// Instantiated for int, std::int64_t, float and double, each with its own block kernel.
+template <typename T>
+void cannon_multiply(
+    std::span<T const> A,
+    std::span<T const> B,
+    std::span<T> C,
+    std::size_t N,
+    std::size_t block_size,
+    std::size_t n_workers,
+    cannon_shift shift = cannon_shift::tiles
+);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <thread_pool.hpp>
+
+// Vertex-valued graph in compressed sparse row form: the neighbours of v are
+// targets[offsets[v], offsets[v + 1]), values[v] is the value aggregated by bfs.
+struct csr_graph
+{
+    std::vector<std::uint64_t> offsets{0};
+    std::vector<std::uint32_t> targets;
+    std::vector<int> values;
+
+    std::size_t size() const
+    {
+        return values.size();
+    }
+
+    std::span<std::uint32_t const> neighbours(std::uint32_t v) const
+    {
+        return std::span(targets).subspan(offsets[v], offsets[v + 1] - offsets[v]);
+    }
+};
+
+using edge = std::pair<std::uint32_t, std::uint32_t>;
+
+// Builds the adjacency of an undirected graph, every edge is stored in both directions
+csr_graph make_csr(std::vector<int> values, std::span<edge const> edges);
+
+// Whitespace-separated text: "n_vertices n_edges", then n_vertices values, then n_edges "u v" pairs.
+// Throws std::runtime_error on malformed input or out of range vertex ids.
+csr_graph load_graph(std::filesystem::path const & path);
+
+// Level-synchronous BFS from source. Each level's frontier is cut into chunks that workers expand
+// into thread-local next frontiers, claiming vertices in a shared visited bitmap; the local
+// frontiers are then concatenated in parallel at prefix-sum offsets. on_level(level, frontier)
+// runs on the calling thread once per level, before the level is expanded.
+void level_bfs(thread_pool & pool, csr_graph const & graph, std::uint32_t source,
+    std::function<void(std::size_t, std::span<std::uint32_t const>)> const & on_level);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <gmpxx.h>
+
+// State of the doubling: [F(k - 1), F(k)]
+struct fib_pair
+{
+    std::size_t k = 1;
+    mpz_class prev = 0; // F(k - 1)
+    mpz_class cur = 1;  // F(k)
+};
+
+// F(N) by doubling, both squarings of every step are multiplied in parallel on the pool
+mpz_class fib(std::size_t N, std::size_t n_workers);
+
+// F(n) for every n in queries, sorted by n with duplicates removed. Sorted queries are cut into
+// segments of nearby indices, one pool task each. Segment starts come from a shared trie of doubling
+// checkpoints, so common binary prefixes are doubled only once. Every later query in a segment is
+// reached by a jump from the previous one: F(m + d) = F(d + 1) F(m) + F(d) F(m - 1), which costs
+// a few products with the small F(d).
+std::vector<std::pair<std::size_t, mpz_class>> fib_batch(std::vector<std::size_t> queries, std::size_t n_workers);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+// Binary tree flattened into level order (struct of arrays). Node i holds values[i], its children are
+// left[i] and right[i] (npos when absent). Nodes of level l occupy [levels[l], levels[l + 1]), so every
+// level is one contiguous index range and children of a level are contiguous in the next one.
+struct flat_tree
+{
+    static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+
+    std::vector<int> values;
+    std::vector<std::uint32_t> left;
+    std::vector<std::uint32_t> right;
+    std::vector<std::size_t> levels{0};
+
+    std::size_t size() const
+    {
+        return values.size();
+    }
+
+    std::size_t n_levels() const
+    {
+        return levels.size() - 1;
+    }
+
+    std::span<int const> level(std::size_t l) const
+    {
+        return std::span(values).subspan(levels[l], levels[l + 1] - levels[l]);
+    }
+
+    // Appends a node to the level being built and returns its index, children are linked by the caller
+    std::uint32_t push(int value)
+    {
+        values.push_back(value);
+        left.push_back(npos);
+        right.push_back(npos);
+        return static_cast<std::uint32_t>(values.size() - 1);
+    }
+
+    // Closes the level being built: everything pushed since the previous call forms the next level
+    void end_level()
+    {
+        levels.push_back(values.size());
+    }
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class gemm_isa
+{
+    scalar,
+    avx2,
+    avx512,
+};
+
+// Widest instruction set usable by the block kernel, detected once via CPUID
+gemm_isa detect_gemm_isa();
+std::string_view gemm_isa_name(gemm_isa isa);
+
+// C[m x n] += A[m x k] * B[k x n], all row-major with leading dimensions lda, ldb, ldc.
+// Operands are packed into contiguous tiles and fed to a register-blocked micro-kernel
+// selected at runtime for the detected instruction set.
+template <typename T>
+void block_gemm(
+    T const * A, std::size_t lda,
+    T const * B, std::size_t ldb,
+    T * C, std::size_t ldc,
+    std::size_t m, std::size_t n, std::size_t k
+);
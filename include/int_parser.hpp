@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Parsers for comma-separated integer files ("1,-20,3"). Whitespace around numbers is ignored,
+// anything else that isn't a number throws std::runtime_error.
+
+// Split text into at most n_parts non-empty pieces that each end right after a ',' (or at the end);
+// throws std::invalid_argument when n_parts is 0
+std::vector<std::string_view> split_at_commas(std::string_view text, std::size_t n_parts);
+
+// Append up to max_count numbers from text to out, returns the number of bytes consumed. offset is where
+// text starts in the file, so error messages give the position in the file rather than in the piece.
+std::size_t parse_ints(std::string_view text, std::vector<int> & out, std::size_t max_count = static_cast<std::size_t>(-1), std::size_t offset = 0);
+
+// Memory-map path and parse it with n_workers threads, one comma-aligned piece each; order is preserved
+std::vector<int> parse_int_file(std::filesystem::path const & path, std::size_t n_workers);
+
+// Parse text in batches of up to batch_size numbers and hand each batch to f(std::span<int const>).
+// Only one batch is alive at a time, so memory use doesn't depend on the input size. offset is where text
+// starts in the file, as for parse_ints.
+template <typename F>
+void for_each_int_batch(std::string_view text, std::size_t offset, F && f, std::size_t batch_size = 4096)
+{
+    std::vector<int> batch;
+    batch.reserve(batch_size);
+    while (!text.empty()) {
+        batch.clear();
+        const auto consumed = parse_ints(text, batch, batch_size, offset);
+        text.remove_prefix(consumed);
+        offset += consumed;
+        if (!batch.empty()) {
+            f(std::span<int const>(batch));
+        }
+    }
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include <gmpxx.h>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#include <parallel_reduce.hpp>
+#include <trace.hpp>
+
+// Per-level aggregates of bfs. The exact product is arbitrary precision; the rest fit in 64 bits
+// (a level holds fewer than 2^32 int values, so |sum| < 2^63).
+enum class aggregate_kind
+{
+    product,
+    product_mod,
+    sum,
+    min,
+    max,
+};
+
+struct aggregate
+{
+    aggregate_kind kind = aggregate_kind::product;
+    std::uint64_t modulus = 1'000'000'007;
+};
+
+// "product", "mod:P" (product modulo P), "sum", "min" or "max"
+inline aggregate parse_aggregate(std::string_view name)
+{
+    if (name == "product") return {aggregate_kind::product};
+    if (name == "sum") return {aggregate_kind::sum};
+    if (name == "min") return {aggregate_kind::min};
+    if (name == "max") return {aggregate_kind::max};
+    if (name.starts_with("mod:")) {
+        const auto modulus = std::stoull(std::string(name.substr(4)));
+        if (modulus == 0) {
+            throw std::invalid_argument("modulus must be positive");
+        }
+        return {aggregate_kind::product_mod, modulus};
+    }
+    throw std::invalid_argument(fmt::format("unknown aggregate: {}", name));
+}
+
+inline std::string aggregate_name(aggregate const & agg)
+{
+    switch (agg.kind) {
+    case aggregate_kind::product: return "product";
+    case aggregate_kind::product_mod: return fmt::format("product mod {}", agg.modulus);
+    case aggregate_kind::sum: return "sum";
+    case aggregate_kind::min: return "min";
+    case aggregate_kind::max: return "max";
+    }
+    return "?";
+}
+
+namespace detail {
+
+inline std::uint64_t residue(int v, std::uint64_t m)
+{
+    const auto r = static_cast<std::uint64_t>(v < 0 ? -static_cast<std::int64_t>(v) : v) % m;
+    return v < 0 && r != 0 ? m - r : r;
+}
+
+// a * b % m without overflow: a 128-bit product where the compiler has one, double-and-add elsewhere
+inline std::uint64_t mul_mod(std::uint64_t a, std::uint64_t b, std::uint64_t m)
+{
+#if defined(__SIZEOF_INT128__)
+    return static_cast<std::uint64_t>(static_cast<unsigned __int128>(a) * b % m);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    std::uint64_t high;
+    const auto low = _umul128(a % m, b % m, &high);
+    std::uint64_t rem;
+    _udiv128(high, low, m, &rem); // high < m, so the quotient fits
+    return rem;
+#else
+    auto add_mod = [m](std::uint64_t x, std::uint64_t y) { return x >= m - y ? x - (m - y) : x + y; };
+    a %= m;
+    b %= m;
+    std::uint64_t res = 0;
+    for (; b != 0; b >>= 1) {
+        if (b & 1) {
+            res = add_mod(res, a);
+        }
+        a = add_mod(a, a);
+    }
+    return res;
+#endif
+}
+
+// Multiplies neighbours pairwise until one factor is left, so both operands of every multiplication
+// have about the same size: O(M(n) log n) instead of the quadratic cost of a running product
+inline mpz_class product_tree(std::vector<mpz_class> factors)
+{
+    if (factors.empty()) {
+        return 1;
+    }
+    while (factors.size() > 1) {
+        const auto half = (factors.size() + 1) / 2;
+        for (std::size_t i = 0; i < factors.size() / 2; ++i) {
+            factors[i] = factors[2 * i] * factors[2 * i + 1];
+        }
+        if (factors.size() % 2 != 0) {
+            factors[half - 1] = std::move(factors.back());
+        }
+        factors.resize(half);
+    }
+    return std::move(factors[0]);
+}
+
+// Same tree over the workers' partial products, the multiplications of each round run on the pool
+inline mpz_class parallel_product_tree(thread_pool & pool, std::vector<mpz_class> factors)
+{
+    if (factors.empty()) {
+        return 1;
+    }
+    while (factors.size() > 1) {
+        const auto half = (factors.size() + 1) / 2;
+        std::vector<mpz_class> next(half);
+        std::vector<task_future<void>> futures;
+        for (std::size_t i = 0; i < factors.size() / 2; ++i) {
+            futures.emplace_back(pool.submit_task([&, i]{ next[i] = factors[2 * i] * factors[2 * i + 1]; }));
+        }
+        if (factors.size() % 2 != 0) {
+            next[half - 1] = std::move(factors.back());
+        }
+        join_all(futures);
+        factors = std::move(next);
+    }
+    return std::move(factors[0]);
+}
+
+// Products with more digits than this are logged as their last digits and the digit count
+constexpr std::size_t max_printed_digits = 1000;
+
+inline std::string format_big(mpz_class const & x)
+{
+    const auto digits = mpz_sizeinbase(x.get_mpz_t(), 10);
+    if (digits <= max_printed_digits) {
+        return x.get_str();
+    }
+    const mpz_class tail = abs(x) % mpz_class("1000000000000000000");
+    // get_ui would truncate the tail where unsigned long has 32 bits
+    return fmt::format("{}...{:0>18} (~{} digits)", sgn(x) < 0 ? "-" : "", tail.get_str(), digits);
+}
+
+} // namespace detail
+
+// Reduces value(i) over i in [0, n) on the pool and formats the result for the log. Fixed-width
+// aggregates go through parallel_reduce; the exact product multiplies each block's values through
+// a product tree and then combines the blocks with a parallel product tree.
+template <typename Value>
+std::string reduce_level(thread_pool & pool, aggregate const & agg, std::size_t n, Value && value)
+{
+    constexpr std::size_t grain = 1 << 16;
+
+    switch (agg.kind) {
+    case aggregate_kind::sum:
+        return fmt::format("{}", parallel_reduce(pool, 0, n, std::int64_t{0}, [&](std::size_t begin, std::size_t end) {
+            std::int64_t acc = 0;
+            for (auto i = begin; i < end; ++i) acc += value(i);
+            return acc;
+        }, std::plus<std::int64_t>{}, grain));
+
+    case aggregate_kind::min:
+        return fmt::format("{}", parallel_reduce(pool, 0, n, std::numeric_limits<int>::max(), [&](std::size_t begin, std::size_t end) {
+            int acc = std::numeric_limits<int>::max();
+            for (auto i = begin; i < end; ++i) acc = std::min(acc, value(i));
+            return acc;
+        }, [](int a, int b) { return std::min(a, b); }, grain));
+
+    case aggregate_kind::max:
+        return fmt::format("{}", parallel_reduce(pool, 0, n, std::numeric_limits<int>::min(), [&](std::size_t begin, std::size_t end) {
+            int acc = std::numeric_limits<int>::min();
+            for (auto i = begin; i < end; ++i) acc = std::max(acc, value(i));
+            return acc;
+        }, [](int a, int b) { return std::max(a, b); }, grain));
+
+    case aggregate_kind::product_mod: {
+        const auto m = agg.modulus;
+        return fmt::format("{}", parallel_reduce(pool, 0, n, std::uint64_t{1 % m}, [&](std::size_t begin, std::size_t end) {
+            std::uint64_t acc = 1 % m;
+            for (auto i = begin; i < end; ++i) acc = detail::mul_mod(acc, detail::residue(value(i), m), m);
+            return acc;
+        }, [m](std::uint64_t a, std::uint64_t b) { return detail::mul_mod(a, b, m); }, grain));
+    }
+
+    case aggregate_kind::product: {
+        // Leaves are runs of values multiplied sequentially: small operands, where a tree doesn't pay off
+        constexpr std::size_t leaf_size = 64;
+        const auto n_blocks = std::clamp<std::size_t>(n / grain, 1, pool.get_thread_count());
+
+        std::vector<mpz_class> partials(n_blocks);
+        std::vector<task_future<void>> futures;
+        for (std::size_t b = 0; b < n_blocks; ++b) {
+            futures.emplace_back(pool.submit_task([&, b]{
+                const auto begin = n * b / n_blocks;
+                const auto end = n * (b + 1) / n_blocks;
+                std::vector<mpz_class> leaves;
+                leaves.reserve((end - begin) / leaf_size + 1);
+                for (auto i = begin; i < end; i += leaf_size) {
+                    mpz_class leaf = 1;
+                    for (auto j = i; j < std::min(end, i + leaf_size); ++j) {
+                        mpz_mul_si(leaf.get_mpz_t(), leaf.get_mpz_t(), value(j));
+                    }
+                    leaves.push_back(std::move(leaf));
+                }
+                partials[b] = detail::product_tree(std::move(leaves));
+            }));
+        }
+        LABS_TRACE_COUNT(tasks, n_blocks);
+        LABS_TRACE_COUNT(elements, n);
+        join_all(futures);
+        return detail::format_big(detail::parallel_product_tree(pool, std::move(partials)));
+    }
+    }
+    return {};
+}
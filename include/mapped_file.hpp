@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+// Read-only memory mapping of a whole file. Throws std::system_error if the file can't be opened or mapped.
+class mapped_file
+{
+public:
+    explicit mapped_file(std::filesystem::path const & path);
+    ~mapped_file();
+
+    mapped_file(mapped_file && other) noexcept;
+    mapped_file & operator=(mapped_file && other) noexcept;
+    mapped_file(mapped_file const &) = delete;
+    mapped_file & operator=(mapped_file const &) = delete;
+
+    std::byte const * data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+    std::span<std::byte const> bytes() const { return {data_, size_}; }
+    std::string_view text() const { return {reinterpret_cast<char const *>(data_), size_}; }
+
+    // Tell the kernel the mapping will be read front to back (read-ahead), a no-op where unsupported
+    void advise_sequential() const;
+
+private:
+    void unmap() noexcept;
+
+    std::byte const * data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void * file_ = nullptr;
+    void * mapping_ = nullptr;
+#endif
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <mapped_file.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+// Raw binary matrix: a 32-byte header followed by rows * cols elements, row-major, native byte order.
+// The header size keeps the payload aligned for every element type when the file is memory-mapped.
+enum class matrix_elem : std::uint32_t
+{
+    i32 = 1,
+    i64 = 2,
+    f32 = 3,
+    f64 = 4,
+};
+
+struct matrix_header
+{
+    char magic[4];
+    matrix_elem elem;
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint64_t reserved;
+};
+
+static_assert(sizeof(matrix_header) == 32);
+
+inline constexpr char matrix_magic[4] = {'M', 'T', 'R', 'X'};
+
+template <typename T> constexpr matrix_elem matrix_elem_of();
+template <> constexpr matrix_elem matrix_elem_of<std::int32_t>() { return matrix_elem::i32; }
+template <> constexpr matrix_elem matrix_elem_of<std::int64_t>() { return matrix_elem::i64; }
+template <> constexpr matrix_elem matrix_elem_of<float>() { return matrix_elem::f32; }
+template <> constexpr matrix_elem matrix_elem_of<double>() { return matrix_elem::f64; }
+
+// Binary matrix mapped read-only from disk, data() points straight into the mapping
+template <typename T>
+class mapped_matrix
+{
+public:
+    explicit mapped_matrix(std::filesystem::path const & path)
+        : file_{path}
+    {
+        if (file_.size() < sizeof(matrix_header)) {
+            throw std::runtime_error(path.string() + ": too small for a matrix header");
+        }
+        std::memcpy(&header_, file_.data(), sizeof(header_));
+        if (std::memcmp(header_.magic, matrix_magic, sizeof(matrix_magic)) != 0) {
+            throw std::runtime_error(path.string() + ": not a binary matrix");
+        }
+        if (header_.elem != matrix_elem_of<T>()) {
+            throw std::runtime_error(path.string() + ": unexpected element type");
+        }
+        // rows * cols * sizeof(T) could overflow for a crafted header, so the bound is divided down instead
+        if (header_.cols != 0 && header_.rows > (file_.size() - sizeof(matrix_header)) / sizeof(T) / header_.cols) {
+            throw std::runtime_error(path.string() + ": truncated payload");
+        }
+    }
+
+    std::size_t rows() const { return header_.rows; }
+    std::size_t cols() const { return header_.cols; }
+
+    std::span<T const> data() const
+    {
+        return {reinterpret_cast<T const *>(file_.data() + sizeof(matrix_header)), rows() * cols()};
+    }
+
+private:
+    mapped_file file_;
+    matrix_header header_;
+};
+
+// Header and payload go out in two writes, without per-element formatting
+template <typename T>
+void write_matrix(std::filesystem::path const & path, std::span<T const> m, std::size_t rows, std::size_t cols)
+{
+    matrix_header header{};
+    std::memcpy(header.magic, matrix_magic, sizeof(matrix_magic));
+    header.elem = matrix_elem_of<T>();
+    header.rows = rows;
+    header.cols = cols;
+
+    std::ofstream file{path, std::ios::binary};
+    file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const *>(m.data()), static_cast<std::streamsize>(rows * cols * sizeof(T)));
+    if (!file) {
+        throw std::runtime_error(path.string() + ": write failed");
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+// Parallel reduction over the persistent pool
+int maximum(std::vector<int> & numbers, std::size_t n_workers);
+
+struct int_stats
+{
+    std::size_t count = 0;
+    int min = std::numeric_limits<int>::max();
+    int max = std::numeric_limits<int>::min();
+    std::int64_t sum = 0;
+    std::size_t argmax = 0; // first occurrence, relative to the start of the range these stats cover
+};
+
+// Fold one parsed batch into s
+void accumulate(int_stats & s, std::span<int const> batch);
+
+// Stats of the right range are merged into those of the left range it directly follows
+void combine(int_stats & left, int_stats const & right);
+
+// Single pass over the mapped file, numbers are folded into stats as they are parsed
+int_stats stream_stats(std::string const & path, std::size_t n_workers);
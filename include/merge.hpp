@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+// Sort numbers in place: n_workers chunks are sorted concurrently, then merged into a buffer by a
+// co-rank partitioned parallel merge. Throws std::invalid_argument when n_workers is 0.
+void merge_sort(std::vector<int> & numbers, std::size_t n_workers);
+
+// Out-of-core sort of the comma-separated file at path into out_path, holding at most memory_budget
+// bytes of numbers at a time; the output is byte-for-byte what the in-memory path writes.
+// Throws std::invalid_argument when n_workers is 0, before anything is read or written.
+void external_sort(std::filesystem::path const & path, std::filesystem::path const & out_path, std::size_t n_workers, std::size_t memory_budget);
@@ -1,3 +1,21 @@
+#pragma once
+
+#include <cstddef>
 #include <cstdint>
 
-double monte_carlo_pi(std::size_t n_points, std::size_t n_workers);
\ No newline at end of file
+// Points come from a Philox stream keyed by seed, so the same (seed, n_points) gives the same
+// estimate for any n_workers
+double monte_carlo_pi(std::size_t n_points, std::size_t n_workers, std::uint64_t seed);
+
+struct monte_carlo_result
+{
+    double pi;
+    double std_error;      // of the estimate, 4 * sqrt(p (1 - p) / n) for hit rate p
+    std::uint64_t n_points;
+    double elapsed_sec;
+};
+
+// Streaming mode: workers sample in batches until the standard error drops to tolerance
+// or max_points have been drawn, logging the running estimate and throughput every second.
+// Throws std::invalid_argument when n_workers is 0.
+monte_carlo_result monte_carlo_pi(double tolerance, std::size_t n_workers, std::uint64_t seed, std::uint64_t max_points = UINT64_MAX);
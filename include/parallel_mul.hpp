@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <span>
+
+#include <gmpxx.h>
+
+#include <thread_pool.hpp>
+
+// Operands with fewer limbs than this are multiplied by a single mpz_mul call
+constexpr std::size_t toom_threshold_limbs = 1 << 13;
+
+// One product of a batch: *out = *a * *b (a == b is a squaring). out must not alias a or b.
+struct mul_job
+{
+    mpz_class const * a;
+    mpz_class const * b;
+    mpz_class * out;
+};
+
+// Computes a batch of independent products on the pool. Large products are split Toom-k style:
+// both operands are cut into k limb ranges, evaluated at 2k - 1 points, the pointwise products run
+// as separate pool tasks and the result is interpolated back. k is chosen so that the whole batch
+// yields about one task per pool thread. Only the calling thread waits, pool tasks never block.
+void parallel_multiply(thread_pool & pool, std::span<mul_job const> jobs);
+
+inline void parallel_multiply(thread_pool & pool, std::initializer_list<mul_job> jobs)
+{
+    parallel_multiply(pool, std::span<mul_job const>(jobs.begin(), jobs.size()));
+}
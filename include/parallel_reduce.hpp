@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include <thread_pool.hpp>
+#include <trace.hpp>
+
+// One partial result per cache line, so workers publishing their partials never share a line
+template <typename T>
+struct alignas(64) padded
+{
+    T value;
+};
+
+// Reduce the index range [first, last): it is cut into at most one block per pool thread, never
+// smaller than grain indices, block(begin, end) reduces one block on the pool, and the partials
+// are folded with op in block order (op has to be associative, not commutative).
+template <typename T, typename BlockFn, typename Op>
+T parallel_reduce(thread_pool & pool, std::size_t first, std::size_t last, T identity, BlockFn && block, Op && op, std::size_t grain = 1)
+{
+    if (last <= first) {
+        return identity;
+    }
+
+    const auto n = last - first;
+    const auto n_blocks = std::clamp<std::size_t>(n / std::max<std::size_t>(grain, 1), 1, pool.get_thread_count());
+
+    std::vector<padded<T>> partials(n_blocks, padded<T>{identity});
+    std::vector<task_future<void>> futures;
+    futures.reserve(n_blocks);
+    for (std::size_t b = 0; b < n_blocks; ++b) {
+        const auto begin = first + n * b / n_blocks;
+        const auto end = first + n * (b + 1) / n_blocks;
+        futures.emplace_back(pool.submit_task([&partials, &block, b, begin, end]{
+            LABS_TRACE_SCOPE("reduce_block");
+            partials[b].value = block(begin, end);
+        }));
+    }
+    LABS_TRACE_COUNT(tasks, n_blocks);
+    LABS_TRACE_COUNT(elements, n);
+    join_all(futures);
+
+    T result = identity;
+    for (auto const & p : partials) {
+        result = op(result, p.value);
+    }
+    return result;
+}
+
+// Element-wise form: each block folds its elements with op(T, E), partials are folded with op(T, T)
+template <typename T, typename E, typename Op>
+T parallel_reduce(thread_pool & pool, std::span<E> range, T identity, Op && op, std::size_t grain = 1)
+{
+    return parallel_reduce(pool, 0, range.size(), identity, [&](std::size_t begin, std::size_t end) {
+        T acc = identity;
+        for (auto i = begin; i < end; ++i) {
+            acc = op(acc, range[i]);
+        }
+        return acc;
+    }, op, grain);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// The output is a pure function of (key, counter), so any element of the stream can be computed
+// directly and independent lanes vectorize.
+namespace philox {
+
+inline constexpr std::uint32_t M0 = 0xD2511F53;
+inline constexpr std::uint32_t M1 = 0xCD9E8D57;
+inline constexpr std::uint32_t W0 = 0x9E3779B9;
+inline constexpr std::uint32_t W1 = 0xBB67AE85;
+inline constexpr int rounds = 10;
+
+inline void round(std::uint32_t & c0, std::uint32_t & c1, std::uint32_t & c2, std::uint32_t & c3, std::uint32_t k0, std::uint32_t k1)
+{
+    const std::uint64_t p0 = std::uint64_t{M0} * c0;
+    const std::uint64_t p1 = std::uint64_t{M1} * c2;
+    const auto hi0 = static_cast<std::uint32_t>(p0 >> 32);
+    const auto lo0 = static_cast<std::uint32_t>(p0);
+    const auto hi1 = static_cast<std::uint32_t>(p1 >> 32);
+    const auto lo1 = static_cast<std::uint32_t>(p1);
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = lo0;
+}
+
+// Four 32-bit outputs for a 64-bit counter under a 64-bit key
+inline std::array<std::uint32_t, 4> generate(std::uint64_t key, std::uint64_t counter)
+{
+    std::uint32_t c0 = static_cast<std::uint32_t>(counter);
+    std::uint32_t c1 = static_cast<std::uint32_t>(counter >> 32);
+    std::uint32_t c2 = 0;
+    std::uint32_t c3 = 0;
+    std::uint32_t k0 = static_cast<std::uint32_t>(key);
+    std::uint32_t k1 = static_cast<std::uint32_t>(key >> 32);
+    for (int r = 0; r < rounds; ++r) {
+        round(c0, c1, c2, c3, k0, k1);
+        k0 += W0;
+        k1 += W1;
+    }
+    return {c0, c1, c2, c3};
+}
+
+} // namespace philox
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// The pool every lab runs on: the work-stealing scheduler, or BS::thread_pool when built with
+// -DLABS_BS_POOL=ON to compare the two. Code only relies on what both provide: submit_task returning
+// a task_future, submit_loop(first, last, f, n_blocks) with wait() and get(), and get_thread_count().
+#ifdef LABS_BS_POOL
+
+#include <future>
+
+#include <BS_thread_pool.hpp>
+
+using thread_pool = BS::thread_pool;
+
+template <typename T>
+using task_future = std::future<T>;
+
+inline constexpr std::string_view thread_pool_name = "BS::thread_pool";
+
+#else
+
+#include <work_stealing_pool.hpp>
+
+using thread_pool = work_stealing_pool;
+
+template <typename T>
+using task_future = work_stealing_future<T>;
+
+inline constexpr std::string_view thread_pool_name = "work-stealing";
+
+#endif
+
+#include <trace.hpp>
+
+// Worker count a pool constructed with n_workers actually gets
+inline std::size_t normalized_thread_count(std::size_t n_workers)
+{
+#ifdef LABS_BS_POOL
+    return n_workers != 0 ? n_workers : std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+#else
+    return std::max<std::size_t>(n_workers, 1);
+#endif
+}
+
+// Process-wide pool reused across calls, rebuilt only when a different worker count is requested.
+// The rebuild destroys the previous pool, so a new count must not be requested while work is still in
+// flight on it or anyone still holds a reference or future of it; the labs switch counts only between calls.
+inline thread_pool & persistent_pool(std::size_t n_workers)
+{
+    static std::mutex mutex;
+    static std::unique_ptr<thread_pool> pool;
+
+    n_workers = normalized_thread_count(n_workers);
+    std::lock_guard lock{mutex};
+    if (!pool || pool->get_thread_count() != n_workers) {
+        pool.reset();
+        pool = std::make_unique<thread_pool>(n_workers);
+    }
+    return *pool;
+}
+
+// Join all futures, then rethrow the first task exception. Sibling tasks typically still reference the
+// caller's stack, so the caller must not unwind before every one of them has finished.
+template <typename Futures>
+void join_all(Futures & futures)
+{
+    for (auto & f : futures) {
+        f.wait();
+    }
+    for (auto & f : futures) {
+        f.get();
+    }
+}
+
+// Fork f(0), ..., f(n - 1) as pool tasks and join them; on a worker the join runs other tasks meanwhile
+template <typename F>
+void run_tasks(thread_pool & pool, std::size_t n, F && f)
+{
+    std::vector<task_future<void>> futures;
+    futures.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        futures.emplace_back(pool.submit_task([&f, i]{ f(i); }));
+    }
+    LABS_TRACE_COUNT(tasks, n);
+    join_all(futures);
+}
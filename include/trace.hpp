@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Compile-time switchable instrumentation (cmake -DLABS_TRACE=ON). Scoped timers go to a per-thread
+// ring buffer, counters are summed per thread, and a trace session in main writes everything out as
+// Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev) and logs per-phase totals on exit.
+// In a normal build every macro below expands to nothing and its arguments are never evaluated.
+//
+//   LABS_TRACE_SESSION("wc");              // in main: $LABS_TRACE_FILE or wc.trace.json
+//   LABS_TRACE_SCOPE("merge");             // the rest of the block is one event
+//   LABS_TRACE_SCOPE_ARG("level", lvl_id); // same, with a number shown in the event's args
+//   LABS_TRACE_COUNT(bytes, file.size());  // tasks, bytes or elements
+
+namespace trace {
+
+enum class counter : std::size_t
+{
+    tasks,    // submitted to a pool or spawned as threads
+    bytes,    // read, written or moved
+    elements, // numbers, words, vertices or limbs processed
+};
+
+inline constexpr std::size_t n_counters = 3;
+
+#ifdef LABS_TRACE
+
+// Events kept per thread; when a ring is full the oldest events are overwritten and reported as dropped
+inline constexpr std::size_t ring_capacity = 1 << 16;
+
+std::uint64_t now_ns();
+
+void record(char const * name, std::uint64_t start_ns, std::uint64_t finish_ns, std::int64_t arg);
+
+void count(counter c, std::uint64_t n);
+
+// name has to outlive the trace, in practice a string literal
+class scope
+{
+public:
+    explicit scope(char const * name, std::int64_t arg = no_arg)
+        : name_{name}
+        , arg_{arg}
+        , start_{now_ns()}
+    {}
+
+    ~scope() { record(name_, start_, now_ns(), arg_); }
+
+    scope(scope const &) = delete;
+    scope & operator=(scope const &) = delete;
+
+    static constexpr std::int64_t no_arg = INT64_MIN;
+
+private:
+    char const * name_;
+    std::int64_t arg_;
+    std::uint64_t start_;
+};
+
+// Writes the trace and logs the summary when it goes out of scope, by then the workers should be idle
+class session
+{
+public:
+    explicit session(std::string const & program);
+    ~session();
+
+    session(session const &) = delete;
+    session & operator=(session const &) = delete;
+
+private:
+    std::string path_;
+};
+
+// Chrome trace-event JSON of everything recorded so far
+void write_chrome_trace(std::string const & path);
+
+// Calls, total and longest duration per event name, then the counter totals
+void log_summary();
+
+#endif
+
+} // namespace trace
+
+#ifdef LABS_TRACE
+
+#define LABS_TRACE_CONCAT_IMPL(a, b) a##b
+#define LABS_TRACE_CONCAT(a, b) LABS_TRACE_CONCAT_IMPL(a, b)
+
+#define LABS_TRACE_SESSION(program) ::trace::session LABS_TRACE_CONCAT(trace_session_, __LINE__){program}
+#define LABS_TRACE_SCOPE(name) ::trace::scope LABS_TRACE_CONCAT(trace_scope_, __LINE__){name}
+#define LABS_TRACE_SCOPE_ARG(name, arg) ::trace::scope LABS_TRACE_CONCAT(trace_scope_, __LINE__){name, static_cast<std::int64_t>(arg)}
+#define LABS_TRACE_COUNT(kind, n) ::trace::count(::trace::counter::kind, static_cast<std::uint64_t>(n))
+
+#else
+
+#define LABS_TRACE_SESSION(program) static_cast<void>(0)
+#define LABS_TRACE_SCOPE(name) static_cast<void>(0)
+#define LABS_TRACE_SCOPE_ARG(name, arg) static_cast<void>(0)
+#define LABS_TRACE_COUNT(kind, n) static_cast<void>(0)
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <word_table.hpp>
+
+// Words are views into the histogram's arena
+using word_list = std::vector<std::tuple<std::string_view, std::size_t>>;
+
+struct word_histogram
+{
+    std::filesystem::path file;
+    word_list map{};
+    std::shared_ptr<word_arena> arena = std::make_shared<word_arena>();
+};
+
+// Histograms are sorted by count (descending), then word; top_k != 0 keeps only the first top_k words
+
+// One histogram per file of the directory, one pool task per file
+std::vector<word_histogram> folder_word_histogram(std::filesystem::path const & path, std::size_t n_workers, std::size_t top_k);
+
+// One histogram over all files of the directory, large files are split across workers
+word_histogram corpus_word_histogram(std::filesystem::path const & path, std::size_t n_workers, std::size_t top_k);
+
+// Per-file histograms, or with corpus the single corpus histogram, backed by the index at index_path:
+// only files that changed since it was written are recounted, and only their records and the change
+// of the corpus counts are appended to it.
+std::vector<word_histogram> incremental_histograms(std::filesystem::path const & path, std::size_t n_workers, std::filesystem::path const & index_path, bool corpus, std::size_t top_k);
+
+// All histograms go to stdout as one buffered block
+void print_histograms(std::vector<word_histogram> const & hists);
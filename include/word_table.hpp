@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// 64-bit FNV-1a, good enough for short words and cheap to compute inline
+inline std::uint64_t word_hash(std::string_view word)
+{
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (const char c : word) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// Open-addressing (linear probing) word -> count table. Keys are views, so whatever they point into
+// (a mapped file, an arena) has to outlive the table. Not thread-safe: one table per thread.
+class word_table
+{
+public:
+    struct entry
+    {
+        std::string_view word;
+        std::uint64_t hash = 0;
+        std::size_t count = 0; // 0 marks an empty slot
+    };
+
+    explicit word_table(std::size_t capacity = 1024)
+        : slots_(round_up_pow2(capacity))
+    {}
+
+    void add(std::string_view word, std::size_t count = 1) { add(word, word_hash(word), count); }
+
+    void add(std::string_view word, std::uint64_t hash, std::size_t count)
+    {
+        if (2 * (size_ + 1) > slots_.size()) {
+            grow();
+        }
+        const auto mask = slots_.size() - 1;
+        for (auto i = hash & mask;; i = (i + 1) & mask) {
+            auto & s = slots_[i];
+            if (s.count == 0) {
+                s = {word, hash, count};
+                ++size_;
+                return;
+            }
+            if (s.hash == hash && s.word == word) {
+                s.count += count;
+                return;
+            }
+        }
+    }
+
+    // Count of word, 0 if it isn't in the table
+    std::size_t count(std::string_view word) const
+    {
+        const auto hash = word_hash(word);
+        const auto mask = slots_.size() - 1;
+        for (auto i = hash & mask;; i = (i + 1) & mask) {
+            auto const & s = slots_[i];
+            if (s.count == 0) {
+                return 0;
+            }
+            if (s.hash == hash && s.word == word) {
+                return s.count;
+            }
+        }
+    }
+
+    std::size_t size() const { return size_; }
+
+    // Visit every (word, hash, count) entry in slot order
+    template <typename F>
+    void for_each(F && f) const
+    {
+        for (auto const & s : slots_) {
+            if (s.count != 0) {
+                f(s);
+            }
+        }
+    }
+
+private:
+    static std::size_t round_up_pow2(std::size_t n)
+    {
+        std::size_t p = 16;
+        while (p < n) p *= 2;
+        return p;
+    }
+
+    void grow()
+    {
+        std::vector<entry> old(slots_.size() * 2);
+        old.swap(slots_);
+        size_ = 0;
+        for (auto const & s : old) {
+            if (s.count != 0) {
+                add(s.word, s.hash, s.count);
+            }
+        }
+    }
+
+    std::vector<entry> slots_;
+    std::size_t size_ = 0;
+};
+
+// Append-only character storage for interned words: each word is copied once into a large block
+// and stays at a stable address for the lifetime of the arena, no per-word heap allocation
+class word_arena
+{
+public:
+    std::string_view intern(std::string_view word)
+    {
+        if (word.size() > capacity_ - used_) {
+            capacity_ = std::max(block_size, word.size());
+            blocks_.push_back(std::make_unique<char[]>(capacity_));
+            used_ = 0;
+        }
+        char * dst = blocks_.back().get() + used_;
+        std::memcpy(dst, word.data(), word.size());
+        used_ += word.size();
+        return {dst, word.size()};
+    }
+
+private:
+    static constexpr std::size_t block_size = 1 << 20;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::size_t used_ = 0;
+    std::size_t capacity_ = 0;
+};
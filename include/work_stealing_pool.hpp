@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Where workers run: not pinned, pinned to consecutive allowed CPUs, or spread round-robin over NUMA
+// nodes (worker i on node i % n_nodes) so every node's memory controller is used and pages first
+// touched by a worker stay local to it. Pinning is a no-op outside Linux.
+enum class placement
+{
+    none,
+    compact,
+    numa,
+};
+
+// "none", "compact" or "numa"; throws std::invalid_argument otherwise
+placement parse_placement(std::string_view name);
+
+std::string_view placement_name(placement p);
+
+// Placement of pools created without an explicit one: $LABS_AFFINITY, none when unset
+placement default_placement();
+
+void set_default_placement(placement p);
+
+class work_stealing_pool;
+
+namespace detail {
+
+struct task_base
+{
+    virtual ~task_base() = default;
+    virtual void run() = 0;
+};
+
+template <typename F>
+struct task_impl final : task_base
+{
+    explicit task_impl(F f) : f{std::move(f)} {}
+    void run() override { f(); }
+    F f;
+};
+
+using task = std::unique_ptr<task_base>;
+
+template <typename T>
+struct future_state
+{
+    using value_type = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    std::atomic<bool> ready{false};
+    std::optional<value_type> value;
+    std::exception_ptr error;
+
+    void set_ready()
+    {
+        ready.store(true, std::memory_order_release);
+        ready.notify_all();
+    }
+};
+
+} // namespace detail
+
+// Result of a submitted task. Waiting on a worker thread of the same pool runs other queued tasks until the
+// result is ready (a helping wait), so tasks may wait for tasks they spawned without starving the pool;
+// any other thread blocks.
+template <typename T>
+class work_stealing_future
+{
+public:
+    work_stealing_future() = default;
+    work_stealing_future(work_stealing_pool * pool, std::shared_ptr<detail::future_state<T>> state)
+        : pool_{pool}
+        , state_{std::move(state)}
+    {}
+
+    bool valid() const { return state_ != nullptr; }
+
+    void wait() const;
+
+    // Rethrows an exception thrown by the task
+    T get();
+
+private:
+    work_stealing_pool * pool_ = nullptr;
+    std::shared_ptr<detail::future_state<T>> state_;
+};
+
+// Work-stealing pool: every worker owns a deque, pops its own tasks newest first and steals the oldest
+// tasks of the others when it runs dry. Tasks submitted from a worker go to its own deque (fork/join:
+// the forked children stay hot in its cache), tasks from other threads are dealt round-robin.
+// Idle workers, and workers waiting for a result with nothing to run, sleep on a condition variable;
+// the destructor runs all queued tasks before joining.
+class work_stealing_pool
+{
+public:
+    explicit work_stealing_pool(std::size_t n_workers, placement where = default_placement());
+    ~work_stealing_pool();
+
+    work_stealing_pool(work_stealing_pool const &) = delete;
+    work_stealing_pool & operator=(work_stealing_pool const &) = delete;
+
+    std::size_t get_thread_count() const { return workers_.size(); }
+    placement get_placement() const { return placement_; }
+
+    // Tasks taken from another worker's deque since the pool was created
+    std::size_t steal_count() const { return steals_.load(std::memory_order_relaxed); }
+
+    template <typename F>
+    auto submit_task(F && f) -> work_stealing_future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        auto state = std::make_shared<detail::future_state<R>>();
+        push(make_task([this, state, f = std::forward<F>(f)]() mutable {
+            try {
+                if constexpr (std::is_void_v<R>) {
+                    f();
+                    state->value.emplace();
+                }
+                else {
+                    state->value.emplace(f());
+                }
+            }
+            catch (...) {
+                state->error = std::current_exception();
+            }
+            state->set_ready();
+            notify_waiters();
+        }));
+        return {this, std::move(state)};
+    }
+
+    // f(i) for every i in [first, last), cut into n_blocks contiguous blocks (one task each; 0 means
+    // one per worker). The future is ready when all blocks are done and rethrows the first exception.
+    template <typename T, typename F>
+    work_stealing_future<void> submit_loop(T first, T last, F && f, std::size_t n_blocks = 0)
+    {
+        auto state = std::make_shared<detail::future_state<void>>();
+        if (last <= first) {
+            state->value.emplace();
+            state->set_ready();
+            return {this, std::move(state)};
+        }
+
+        const auto n = static_cast<std::size_t>(last - first);
+        n_blocks = std::clamp<std::size_t>(n_blocks == 0 ? get_thread_count() : n_blocks, 1, n);
+
+        struct loop
+        {
+            std::decay_t<F> f;
+            std::atomic<std::size_t> remaining;
+            std::mutex error_mutex;
+        };
+        auto shared = std::make_shared<loop>(std::forward<F>(f), n_blocks);
+
+        for (std::size_t b = 0; b < n_blocks; ++b) {
+            const auto begin = first + static_cast<T>(n * b / n_blocks);
+            const auto end = first + static_cast<T>(n * (b + 1) / n_blocks);
+            push(make_task([this, state, shared, begin, end] {
+                try {
+                    for (auto i = begin; i < end; ++i) {
+                        shared->f(i);
+                    }
+                }
+                catch (...) {
+                    std::lock_guard lock{shared->error_mutex};
+                    if (!state->error) {
+                        state->error = std::current_exception();
+                    }
+                }
+                if (shared->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    state->value.emplace();
+                    state->set_ready();
+                    notify_waiters();
+                }
+            }));
+        }
+        return {this, std::move(state)};
+    }
+
+    // Returns once flag is set: worker threads of this pool run queued tasks meanwhile and sleep when
+    // there are none, others block
+    void wait_for(std::atomic<bool> const & flag);
+
+private:
+    struct alignas(64) worker_queue
+    {
+        std::mutex mutex;
+        std::deque<detail::task> tasks;
+    };
+
+    template <typename F>
+    static detail::task make_task(F && f)
+    {
+        return std::make_unique<detail::task_impl<std::decay_t<F>>>(std::forward<F>(f));
+    }
+
+    void push(detail::task t);
+    detail::task pop(std::size_t self);
+    bool run_one(std::size_t self);
+    void worker_loop(std::size_t self);
+
+    // Wakes workers sleeping in wait_for after a future became ready
+    void notify_waiters();
+
+    // Index of the calling thread among this pool's workers, or npos
+    std::size_t current_worker() const;
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    placement placement_;
+    std::vector<std::unique_ptr<worker_queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<std::size_t> next_queue_{0};
+    std::atomic<std::size_t> steals_{0};
+    std::atomic<std::size_t> waiting_{0}; // workers asleep in wait_for
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+};
+
+template <typename T>
+void work_stealing_future<T>::wait() const
+{
+    pool_->wait_for(state_->ready);
+}
+
+template <typename T>
+T work_stealing_future<T>::get()
+{
+    wait();
+    auto state = std::move(state_);
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+    if constexpr (!std::is_void_v<T>) {
+        return std::move(*state->value);
+    }
+}
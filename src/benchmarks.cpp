@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include <nlohmann/json.hpp>
+
+#include <bfs.hpp>
+#include <cannon.hpp>
+#include <fibonacci.hpp>
+#include <max.hpp>
+#include <merge.hpp>
+#include <monte_carlo.hpp>
+#include <thread_pool.hpp>
+#include <wc.hpp>
+#include <work_stealing_pool.hpp>
+
+// Benchmark suite over the labs' entry points: synthetic inputs of configurable size, a sweep over
+// worker counts, warm-up plus repeated runs, and order statistics of the wall times with speedup
+// and efficiency relative to the first worker count. Logging of the labs is silenced while timing.
+//
+//   benchmarks [--only cannon,fib] [--workers 1,2,4] [--repeats 5] [--warmup 1]
+//              [--size name=value]... [--affinity none|compact|numa] [--tmp DIR] [--json FILE] [--csv FILE]
+
+namespace fs = std::filesystem;
+
+struct benchmark
+{
+    std::string name;
+    std::string size_unit;
+    std::size_t size;
+    std::function<void(std::size_t)> setup;     // builds the input for a size, once, untimed
+    std::function<void()> prepare;              // before every run, untimed (e.g. restoring unsorted input)
+    std::function<void(std::size_t)> run;       // the timed call with n_workers
+    std::function<void()> teardown;
+};
+
+struct stats
+{
+    double min, p10, median, p90, max, mean;
+};
+
+struct result
+{
+    std::string name;
+    std::size_t size;
+    std::size_t n_workers;
+    std::vector<double> samples_ms;
+    stats s;
+    double speedup = 0;
+    double efficiency = 0;
+};
+
+stats summarize(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    auto q = [&](double p) { return samples[static_cast<std::size_t>(p * (samples.size() - 1) + 0.5)]; };
+    const auto mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    return {samples.front(), q(0.1), q(0.5), q(0.9), samples.back(), mean};
+}
+
+std::vector<int> random_ints(std::size_t n, int lo, int hi, std::uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> dist(lo, hi);
+    std::vector<int> v(n);
+    for (auto & x : v) {
+        x = dist(rng);
+    }
+    return v;
+}
+
+// Zipf-like text: word i of the vocabulary is picked with probability about 1 / i
+void write_corpus(fs::path const & dir, std::size_t n_words, std::size_t n_files)
+{
+    constexpr std::size_t vocabulary = 20000;
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+
+    fs::create_directories(dir);
+    for (std::size_t f = 0; f < n_files; ++f) {
+        std::string text;
+        for (std::size_t w = f; w < n_words; w += n_files) {
+            const auto rank = static_cast<std::size_t>(std::pow(static_cast<double>(vocabulary), u(rng)));
+            text += "w";
+            text += std::to_string(rank);
+            text += w % 7 == 0 ? ',' : ' ';
+        }
+        std::ofstream{dir / fmt::format("{}.txt", f), std::ios::binary} << text;
+    }
+}
+
+// Fresh directory parallel-labs-bench-<random> under parent; the benchmarks only ever delete what is inside it
+fs::path make_work_dir(fs::path const & parent)
+{
+    std::random_device rd;
+    for (;;) {
+        auto dir = parent / fmt::format("parallel-labs-bench-{:08x}", rd());
+        fs::create_directories(parent);
+        if (fs::create_directory(dir)) {
+            return dir;
+        }
+    }
+}
+
+// Complete binary tree in level order with small values, so exact aggregates stay cheap
+flat_tree complete_tree(std::size_t n_nodes)
+{
+    flat_tree tree;
+    const auto values = random_ints(n_nodes, -1, 2, 11);
+    std::size_t level_end = 1;
+    for (std::size_t i = 0; i < n_nodes; ++i) {
+        tree.push(values[i] == 0 ? 1 : values[i]);
+        if (i + 1 == level_end || i + 1 == n_nodes) {
+            tree.end_level();
+            level_end = 2 * level_end + 1;
+        }
+    }
+    for (std::size_t i = 0; 2 * i + 1 < n_nodes; ++i) {
+        tree.left[i] = static_cast<std::uint32_t>(2 * i + 1);
+        if (2 * i + 2 < n_nodes) {
+            tree.right[i] = static_cast<std::uint32_t>(2 * i + 2);
+        }
+    }
+    return tree;
+}
+
+std::vector<benchmark> make_benchmarks(fs::path const & tmp_dir)
+{
+    std::vector<benchmark> benches;
+
+    {
+        auto a = std::make_shared<std::vector<int>>();
+        auto b = std::make_shared<std::vector<int>>();
+        auto c = std::make_shared<std::vector<int>>();
+        auto n = std::make_shared<std::size_t>();
+        benches.push_back({"cannon", "N", 1024,
+            [=](std::size_t size) { *n = size; *a = random_ints(size * size, -100, 100, 1); *b = random_ints(size * size, -100, 100, 2); c->resize(size * size); },
+            {},
+            [=](std::size_t w) { cannon_multiply<int>(*a, *b, *c, *n, 0, w); },
+            [=] { *a = {}; *b = {}; *c = {}; }});
+    }
+    {
+        auto n = std::make_shared<std::size_t>();
+        benches.push_back({"monte-carlo", "points", std::size_t{1} << 28,
+            [=](std::size_t size) { *n = size; },
+            {},
+            [=](std::size_t w) { monte_carlo_pi(*n, w, 42); },
+            {}});
+    }
+    {
+        auto input = std::make_shared<std::vector<int>>();
+        auto work = std::make_shared<std::vector<int>>();
+        benches.push_back({"merge", "ints", std::size_t{1} << 24,
+            [=](std::size_t size) { *input = random_ints(size, -1'000'000'000, 1'000'000'000, 3); },
+            [=] { *work = *input; },
+            [=](std::size_t w) { merge_sort(*work, w); },
+            [=] { *input = {}; *work = {}; }});
+    }
+    {
+        auto input = std::make_shared<std::vector<int>>();
+        benches.push_back({"max", "ints", std::size_t{1} << 26,
+            [=](std::size_t size) { *input = random_ints(size, -1'000'000'000, 1'000'000'000, 4); },
+            {},
+            [=](std::size_t w) { maximum(*input, w); },
+            [=] { *input = {}; }});
+    }
+    {
+        auto dir = std::make_shared<fs::path>();
+        benches.push_back({"wc", "words", std::size_t{1} << 23,
+            [=](std::size_t size) { *dir = make_work_dir(tmp_dir); write_corpus(*dir, size, 64); },
+            {},
+            [=](std::size_t w) { folder_word_histogram(*dir, w, 0); },
+            [=] { std::error_code ec; fs::remove_all(*dir, ec); }});
+    }
+    {
+        auto tree = std::make_shared<flat_tree>();
+        benches.push_back({"bfs", "nodes", std::size_t{1} << 24,
+            [=](std::size_t size) { *tree = complete_tree(size); },
+            {},
+            [=](std::size_t w) { bfs(*tree, w, parse_aggregate("mod:1000000007")); },
+            [=] { *tree = {}; }});
+    }
+    {
+        auto n = std::make_shared<std::size_t>();
+        benches.push_back({"fib", "N", 10'000'000,
+            [=](std::size_t size) { *n = size; },
+            {},
+            [=](std::size_t w) { fib(*n, w); },
+            {}});
+    }
+    return benches;
+}
+
+template <typename T>
+std::vector<T> parse_list(std::string_view text, std::function<T(std::string const &)> parse)
+{
+    std::vector<T> res;
+    while (!text.empty()) {
+        const auto comma = text.find(',');
+        res.push_back(parse(std::string(text.substr(0, comma))));
+        text.remove_prefix(comma == std::string_view::npos ? text.size() : comma + 1);
+    }
+    return res;
+}
+
+// Placement the timed pools really use: BS::thread_pool never pins its workers
+placement effective_placement()
+{
+#ifdef LABS_BS_POOL
+    return placement::none;
+#else
+    return default_placement();
+#endif
+}
+
+std::vector<std::size_t> default_workers()
+{
+    const std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::size_t> res;
+    for (std::size_t w = 1; w < cores; w *= 2) {
+        res.push_back(w);
+    }
+    res.push_back(cores);
+    return res;
+}
+
+void write_json(fs::path const & path, std::vector<result> const & results, std::size_t repeats, std::size_t warmup)
+{
+    nlohmann::json doc;
+    doc["hw_cores"] = std::thread::hardware_concurrency();
+    doc["pool"] = thread_pool_name;
+    doc["affinity"] = placement_name(effective_placement());
+    doc["repeats"] = repeats;
+    doc["warmup"] = warmup;
+    doc["results"] = nlohmann::json::array();
+    for (auto const & r : results) {
+        doc["results"].push_back({
+            {"name", r.name}, {"size", r.size}, {"workers", r.n_workers}, {"samples_ms", r.samples_ms},
+            {"min_ms", r.s.min}, {"p10_ms", r.s.p10}, {"median_ms", r.s.median}, {"p90_ms", r.s.p90},
+            {"max_ms", r.s.max}, {"mean_ms", r.s.mean}, {"speedup", r.speedup}, {"efficiency", r.efficiency},
+        });
+    }
+    std::ofstream{path} << doc.dump(2) << '\n';
+}
+
+void write_csv(fs::path const & path, std::vector<result> const & results)
+{
+    std::ofstream out{path};
+    out << "name,size,workers,min_ms,p10_ms,median_ms,p90_ms,max_ms,mean_ms,speedup,efficiency\n";
+    for (auto const & r : results) {
+        out << fmt::format("{},{},{},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f}\n",
+            r.name, r.size, r.n_workers, r.s.min, r.s.p10, r.s.median, r.s.p90, r.s.max, r.s.mean, r.speedup, r.efficiency);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> only;
+    std::vector<std::size_t> workers = default_workers();
+    std::size_t repeats = 5;
+    std::size_t warmup = 1;
+    std::map<std::string, std::size_t> sizes;
+    fs::path tmp_dir = fs::temp_directory_path();
+    std::string json_path;
+    std::string csv_path;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (arg == "--only" && has_value) {
+                only = parse_list<std::string>(argv[++i], [](std::string const & s) { return s; });
+            }
+            else if (arg == "--workers" && has_value) {
+                workers = parse_list<std::size_t>(argv[++i], [](std::string const & s) { return std::stoull(s); });
+            }
+            else if (arg == "--repeats" && has_value) {
+                repeats = std::max<std::size_t>(1, std::stoull(argv[++i]));
+            }
+            else if (arg == "--warmup" && has_value) {
+                warmup = std::stoull(argv[++i]);
+            }
+            else if (arg == "--size" && has_value) {
+                const std::string spec = argv[++i];
+                const auto eq = spec.find('=');
+                if (eq == std::string::npos) {
+                    throw std::invalid_argument(fmt::format("expected name=value, got {}", spec));
+                }
+                sizes[spec.substr(0, eq)] = std::stoull(spec.substr(eq + 1));
+            }
+            else if (arg == "--affinity" && has_value) {
+                set_default_placement(parse_placement(argv[++i]));
+#ifdef LABS_BS_POOL
+                spdlog::warn("--affinity has no effect with BS::thread_pool");
+#endif
+            }
+            else if (arg == "--tmp" && has_value) {
+                tmp_dir = argv[++i];
+            }
+            else if (arg == "--json" && has_value) {
+                json_path = argv[++i];
+            }
+            else if (arg == "--csv" && has_value) {
+                csv_path = argv[++i];
+            }
+            else {
+                throw std::invalid_argument(fmt::format("unknown argument: {}", arg));
+            }
+        }
+    }
+    catch (std::exception const & e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+    if (workers.empty() || std::find(workers.begin(), workers.end(), 0) != workers.end()) {
+        spdlog::error("worker counts must be positive");
+        return 1;
+    }
+
+    auto benches = make_benchmarks(tmp_dir);
+    auto known = [&](std::string const & name) {
+        return std::any_of(benches.begin(), benches.end(), [&](benchmark const & b) { return b.name == name; });
+    };
+    for (auto const & [name, size] : sizes) {
+        if (!known(name)) {
+            spdlog::error("unknown benchmark: {}", name);
+            return 1;
+        }
+    }
+    for (auto const & name : only) {
+        if (!known(name)) {
+            spdlog::error("unknown benchmark: {}", name);
+            return 1;
+        }
+    }
+
+    spdlog::info("{} pool, affinity {} | workers {} | {} runs after {} warm-up | {} hw cores",
+        thread_pool_name, placement_name(effective_placement()), fmt::join(workers, ","), repeats, warmup, std::thread::hardware_concurrency());
+    fmt::print("{:<12} {:>12} {:>7} {:>10} {:>10} {:>10} {:>10} {:>8} {:>6}\n",
+        "benchmark", "size", "workers", "min ms", "median ms", "p90 ms", "mean ms", "speedup", "eff");
+
+    // Tears the benchmark down however its run is left, so a failure never strands its temporary files
+    struct teardown_guard
+    {
+        benchmark & b;
+        ~teardown_guard()
+        {
+            if (!b.teardown) {
+                return;
+            }
+            try {
+                b.teardown();
+            }
+            catch (std::exception const & e) {
+                spdlog::warn("{} teardown failed: {}", b.name, e.what());
+            }
+        }
+    };
+
+    const auto log_level = spdlog::get_level();
+    std::vector<result> results;
+    for (auto & b : benches) {
+        if (!only.empty() && std::find(only.begin(), only.end(), b.name) == only.end()) {
+            continue;
+        }
+        const auto size = sizes.contains(b.name) ? sizes[b.name] : b.size;
+
+        try {
+            const teardown_guard guard{b};
+            b.setup(size);
+
+            double base_median = 0;
+            for (const auto w : workers) {
+                std::vector<double> samples;
+                spdlog::set_level(spdlog::level::warn);
+                for (std::size_t r = 0; r < warmup + repeats; ++r) {
+                    if (b.prepare) {
+                        b.prepare();
+                    }
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    b.run(w);
+                    const auto finish = std::chrono::high_resolution_clock::now();
+                    if (r >= warmup) {
+                        samples.push_back(std::chrono::duration<double, std::milli>(finish - start).count());
+                    }
+                }
+                spdlog::set_level(log_level);
+
+                result res{b.name, size, w, samples, summarize(samples)};
+                if (w == workers.front()) {
+                    base_median = res.s.median;
+                }
+                res.speedup = base_median / res.s.median;
+                res.efficiency = res.speedup * static_cast<double>(workers.front()) / static_cast<double>(w);
+
+                fmt::print("{:<12} {:>12} {:>7} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f} {:>8.2f} {:>6.2f}\n",
+                    b.name, fmt::format("{} {}", size, b.size_unit), w, res.s.min, res.s.median, res.s.p90, res.s.mean, res.speedup, res.efficiency);
+                std::fflush(stdout);
+                results.push_back(std::move(res));
+            }
+        }
+        catch (std::exception const & e) {
+            spdlog::set_level(log_level);
+            spdlog::error("{}: {}", b.name, e.what());
+            return 1;
+        }
+    }
+
+    if (!json_path.empty()) {
+        write_json(json_path, results, repeats, warmup);
+    }
+    if (!csv_path.empty()) {
+        write_csv(csv_path, results);
+    }
+}
@@ -5,86 +5,271 @@
 #include <span>
 #include <algorithm>
 #include <filesystem>
-#include <map>
-#include <queue>
-#include <mutex>
+#include <stdexcept>
+#include <string_view>
 
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/std.h>
 
-#include <BS_thread_pool.hpp>
-
 #include <nlohmann/json.hpp>
 
+#include <bfs.hpp>
+#include <mapped_file.hpp>
+#include <parallel_reduce.hpp>
+#include <trace.hpp>
+
 using nlohmann::json;
 
-void bfs(json const & root, std::size_t n_workers)
+// SAX handler that lays the tree out while the file is parsed, no DOM is ever built. Nodes are appended
+// to per-depth arrays in document order, which is level order as long as "left" precedes "right" in
+// each object; the only state besides the arrays is one frame per open object. Empty or null
+// children count as absent, members other than value/left/right are skipped.
+class tree_builder
 {
-    std::mutex mtx;
+public:
+    bool null() { return scalar(); }
+    bool boolean(bool) { return scalar(); }
+    bool number_integer(json::number_integer_t v) { return number(static_cast<int>(v)); }
+    bool number_unsigned(json::number_unsigned_t v) { return number(static_cast<int>(v)); }
+    bool number_float(json::number_float_t v, json::string_t const &) { return number(static_cast<int>(v)); }
+    bool string(json::string_t &) { return scalar(); }
+    bool binary(json::binary_t &) { return scalar(); }
 
-    BS::thread_pool pool(n_workers);
+    bool start_object(std::size_t)
+    {
+        if (skip_ == 0 && (stack_.empty() ? levels_.empty() : stack_.back().pending == slot::left || stack_.back().pending == slot::right)) {
+            open_node();
+        }
+        else {
+            skip();
+        }
+        return true;
+    }
 
-    struct level
+    bool key(json::string_t & k)
     {
-        int mul_value;
-        int elapsed_mcs;
-    };
+        if (skip_ == 0) {
+            auto & top = stack_.back();
+            top.pending = k == "value" ? slot::value : k == "left" ? slot::left : k == "right" ? slot::right : slot::none;
+            top.empty = false;
+        }
+        return true;
+    }
 
-    std::vector<level> res;
-    std::queue<json> current_lvl;
-    current_lvl.push(root);
+    bool end_object()
+    {
+        if (skip_ > 0) {
+            --skip_;
+            return true;
+        }
+        close_node();
+        return true;
+    }
 
-    std::size_t lvl_id = 0;
+    bool start_array(std::size_t)
+    {
+        skip();
+        return true;
+    }
 
-    while (!current_lvl.empty()) {
-        std::queue<json> next_lvl;
-        std::vector<std::future<int>> futures;
+    bool end_array()
+    {
+        --skip_;
+        return true;
+    }
 
-        const auto start = std::chrono::high_resolution_clock::now();
+    bool parse_error(std::size_t position, std::string const &, nlohmann::detail::exception const & e)
+    {
+        throw std::runtime_error(fmt::format("tree parse error at byte {}: {}", position, e.what()));
+    }
 
-        while (!current_lvl.empty()) {
-            auto node = current_lvl.front();
-            current_lvl.pop();
+    // Concatenates the levels into one flat_tree, releasing each level as soon as it is copied
+    flat_tree finish()
+    {
+        while (!levels_.empty() && levels_.back().values.empty()) {
+            levels_.pop_back();
+        }
+        if (levels_.empty()) {
+            throw std::runtime_error("tree has no nodes");
+        }
 
-            futures.emplace_back(pool.submit_task([&, node]{
-                int value = node["value"];
+        std::size_t total = 0;
+        for (auto const & l : levels_) {
+            total += l.values.size();
+        }
 
-                if (node.contains("left") && !node["left"].empty()) {
-                    std::unique_lock lock{mtx};
-                    next_lvl.push(node["left"]);
-                }
-                if (node.contains("right") && !node["right"].empty()) {
-                    std::unique_lock lock{mtx};
-                    next_lvl.push(node["right"]);
-                }
+        flat_tree tree;
+        tree.values.reserve(total);
+        tree.left.reserve(total);
+        tree.right.reserve(total);
 
-                return value;
-            }));
+        auto global = [](std::uint32_t local, std::size_t offset) {
+            return local == flat_tree::npos ? local : static_cast<std::uint32_t>(offset + local);
+        };
+        for (std::size_t d = 0; d < levels_.size(); ++d) {
+            auto & l = levels_[d];
+            const auto next_offset = tree.size() + l.values.size();
+            tree.values.insert(tree.values.end(), l.values.begin(), l.values.end());
+            for (std::size_t i = 0; i < l.values.size(); ++i) {
+                tree.left.push_back(global(l.left[i], next_offset));
+                tree.right.push_back(global(l.right[i], next_offset));
+            }
+            tree.end_level();
+            l = {};
         }
+        return tree;
+    }
+
+private:
+    enum class slot { none, value, left, right };
 
-        int lvl_product = 1;
-        for (auto & f : futures) {
-            lvl_product *= f.get();
+    struct frame
+    {
+        std::uint32_t index; // within its level
+        slot pending = slot::none;
+        bool has_value = false;
+        bool empty = true;
+    };
+
+    struct level_nodes
+    {
+        std::vector<int> values;
+        std::vector<std::uint32_t> left;
+        std::vector<std::uint32_t> right;
+    };
+
+    bool scalar()
+    {
+        if (skip_ == 0 && !stack_.empty()) {
+            if (stack_.back().pending == slot::value) {
+                throw std::runtime_error("node value is not a number");
+            }
+            stack_.back().pending = slot::none;
         }
+        return true;
+    }
+
+    bool number(int v)
+    {
+        if (skip_ == 0 && !stack_.empty() && stack_.back().pending == slot::value) {
+            auto & top = stack_.back();
+            levels_[stack_.size() - 1].values[top.index] = v;
+            top.has_value = true;
+            top.pending = slot::none;
+        }
+        return scalar();
+    }
+
+    void skip()
+    {
+        if (skip_ == 0 && !stack_.empty()) {
+            stack_.back().pending = slot::none;
+        }
+        ++skip_;
+    }
+
+    void open_node()
+    {
+        const auto depth = stack_.size();
+        if (levels_.size() <= depth) {
+            levels_.emplace_back();
+        }
+
+        auto & l = levels_[depth];
+        const auto index = static_cast<std::uint32_t>(l.values.size());
+        l.values.push_back(0);
+        l.left.push_back(flat_tree::npos);
+        l.right.push_back(flat_tree::npos);
+
+        if (depth > 0) {
+            auto & parent = stack_.back();
+            auto & links = parent.pending == slot::left ? levels_[depth - 1].left : levels_[depth - 1].right;
+            links[parent.index] = index;
+            parent.pending = slot::none;
+        }
+        stack_.push_back({index});
+    }
+
+    void close_node()
+    {
+        const auto node = stack_.back();
+        stack_.pop_back();
+        const auto depth = stack_.size();
+
+        if (node.empty) {
+            // {} child: it is the last node of its level and has no descendants, so it is simply dropped
+            auto & l = levels_[depth];
+            l.values.pop_back();
+            l.left.pop_back();
+            l.right.pop_back();
+            if (depth > 0) {
+                auto & parent = levels_[depth - 1];
+                for (auto links : {&parent.left, &parent.right}) {
+                    if ((*links)[stack_.back().index] == node.index) {
+                        (*links)[stack_.back().index] = flat_tree::npos;
+                    }
+                }
+            }
+            return;
+        }
+        if (!node.has_value) {
+            throw std::runtime_error(fmt::format("node {} of level {} has no value", node.index, depth));
+        }
+    }
+
+    std::vector<level_nodes> levels_;
+    std::vector<frame> stack_;
+    std::size_t skip_ = 0;
+};
+
+// Streams the mapped file through the SAX parser straight into the level arrays
+flat_tree load_tree(std::string const & path)
+{
+    const mapped_file file{path};
+    file.advise_sequential();
+
+    LABS_TRACE_SCOPE("parse");
+    LABS_TRACE_COUNT(bytes, file.size());
+    const auto text = file.text();
+    tree_builder builder;
+    json::sax_parse(text.begin(), text.end(), &builder);
+    return builder.finish();
+}
+
+void bfs(flat_tree const & tree, std::size_t n_workers, aggregate const & agg)
+{
+    auto & pool = persistent_pool(n_workers);
+
+    for (std::size_t lvl_id = 0; lvl_id < tree.n_levels(); ++lvl_id) {
+        LABS_TRACE_SCOPE_ARG("level", lvl_id);
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        const auto level = tree.level(lvl_id);
+        const auto result = reduce_level(pool, agg, level.size(), [&](std::size_t i) { return level[i]; });
 
         const auto finish = std::chrono::high_resolution_clock::now();
         const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
 
         spdlog::info("elapsed {}mcs for lvl {}", elapsed, lvl_id);
-        spdlog::info("product: {}", lvl_product);
-
-        current_lvl = std::move(next_lvl);
-        lvl_id++;
+        spdlog::info("{}: {}", aggregate_name(agg), result);
     }
 }
 
-int main(int argc, char** argv)
+void bfs(csr_graph const & graph, std::uint32_t source, std::size_t n_workers, aggregate const & agg)
 {
-    const std::string path = argv[1];
-    const std::size_t n_workers = std::stoull(argv[2]);
+    auto & pool = persistent_pool(n_workers);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    level_bfs(pool, graph, source, [&](std::size_t lvl_id, std::span<std::uint32_t const> frontier) {
+        LABS_TRACE_SCOPE_ARG("level", lvl_id);
+        const auto result = reduce_level(pool, agg, frontier.size(), [&](std::size_t i) { return graph.values[frontier[i]]; });
 
-    std::ifstream file{path};
-    auto data = json::parse(file);
+        // A level's time covers expanding the previous frontier into it and reducing it
+        const auto finish = std::chrono::high_resolution_clock::now();
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+        start = finish;
 
-    bfs(data, n_workers);
+        spdlog::info("elapsed {}mcs for lvl {} ({} vertices)", elapsed, lvl_id, frontier.size());
+        spdlog::info("{}: {}", aggregate_name(agg), result);
+    });
 }
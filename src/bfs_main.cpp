@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/std.h>
+
+#include <bfs.hpp>
+#include <trace.hpp>
+
+int main(int argc, char** argv)
+{
+    LABS_TRACE_SESSION("bfs");
+    const std::string path = argv[1];
+    const std::size_t n_workers = std::stoull(argv[2]);
+
+    bool graph_input = false;
+    std::uint32_t source = 0;
+    aggregate agg;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--graph") {
+            graph_input = true;
+        }
+        else if (arg == "--source" && i + 1 < argc) {
+            source = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--aggregate" && i + 1 < argc) {
+            try {
+                agg = parse_aggregate(argv[++i]);
+            }
+            catch (std::exception const & e) {
+                spdlog::error("{}", e.what());
+                return 1;
+            }
+        }
+        else {
+            spdlog::error("unknown argument: {}", arg);
+            return 1;
+        }
+    }
+
+    const auto load_start = std::chrono::high_resolution_clock::now();
+
+    flat_tree tree;
+    csr_graph graph;
+    try {
+        if (graph_input) {
+            graph = load_graph(path);
+        }
+        else {
+            tree = load_tree(path);
+        }
+    }
+    catch (std::exception const & e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+
+    const auto load_finish = std::chrono::high_resolution_clock::now();
+    const auto load_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(load_finish - load_start).count();
+    const auto mb = static_cast<double>(std::filesystem::file_size(path)) / (1 << 20);
+    const auto mb_per_sec = mb / std::max<double>(load_elapsed, 1) * 1e6;
+
+    if (graph_input) {
+        spdlog::info("loaded {} vertices and {} edges in {}mcs ({:.1f} MB/s)", graph.size(), graph.targets.size() / 2, load_elapsed, mb_per_sec);
+        try {
+            bfs(graph, source, n_workers, agg);
+        }
+        catch (std::exception const & e) {
+            spdlog::error("{}", e.what());
+            return 1;
+        }
+        return 0;
+    }
+
+    spdlog::info("loaded {} nodes in {} levels in {}mcs ({:.1f} MB/s)", tree.size(), tree.n_levels(), load_elapsed, mb_per_sec);
+    bfs(tree, n_workers, agg);
+}
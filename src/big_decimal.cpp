@@ -0,0 +1,53 @@
+#include <big_decimal.hpp>
+#include <parallel_mul.hpp>
+#include <trace.hpp>
+
+#include <algorithm>
+#include <vector>
+
+std::string to_decimal(thread_pool & pool, mpz_class const & x)
+{
+    LABS_TRACE_SCOPE("to_decimal");
+    const auto n_threads = pool.get_thread_count();
+    const auto max_digits = mpz_sizeinbase(x.get_mpz_t(), 10); // exact or one too many
+
+    // About four leaves per thread, but never smaller than min_leaf_digits
+    std::size_t depth = 0;
+    while ((std::size_t{1} << depth) < 4 * n_threads && (max_digits >> (depth + 1)) >= min_leaf_digits) {
+        ++depth;
+    }
+    if (depth == 0 || n_threads < 2) {
+        return x.get_str();
+    }
+
+    const auto n_leaves = std::size_t{1} << depth;
+    const auto leaf = (max_digits + n_leaves - 1) / n_leaves;
+
+    // powers[j] = 10^(leaf * 2^j) splits a piece of leaf * 2^(j + 1) digits into two halves
+    std::vector<mpz_class> powers(depth);
+    mpz_ui_pow_ui(powers[0].get_mpz_t(), 10, leaf);
+    for (std::size_t j = 1; j < depth; ++j) {
+        parallel_multiply(pool, {{&powers[j - 1], &powers[j - 1], &powers[j]}});
+    }
+
+    std::vector<mpz_class> pieces{abs(x)};
+    for (auto j = depth; j-- > 0;) {
+        std::vector<mpz_class> next(pieces.size() * 2);
+        run_tasks(pool, pieces.size(), [&](std::size_t i) {
+            mpz_tdiv_qr(next[2 * i].get_mpz_t(), next[2 * i + 1].get_mpz_t(), pieces[i].get_mpz_t(), powers[j].get_mpz_t());
+        });
+        pieces = std::move(next);
+    }
+
+    std::string digits(leaf * n_leaves, '0');
+    run_tasks(pool, n_leaves, [&](std::size_t i) {
+        const auto s = pieces[i].get_str();
+        std::copy(s.begin(), s.end(), digits.begin() + (i + 1) * leaf - s.size());
+    });
+
+    digits.erase(0, std::min(digits.find_first_not_of('0'), digits.size() - 1));
+    if (sgn(x) < 0) {
+        digits.insert(digits.begin(), '-');
+    }
+    return digits;
+}
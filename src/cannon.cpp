@@ -1,64 +1,33 @@
 #include <cannon.hpp>
+#include <gemm.hpp>
+#include <thread_pool.hpp>
+#include <trace.hpp>
 
-#include <random>
-#include <chrono>
-#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
 
 #include <spdlog/spdlog.h>
-#include <spdlog/fmt/ranges.h>
 
-#include <range/v3/view/chunk.hpp>
-#include <range/v3/view/transform.hpp>
 #include <range/v3/view/stride.hpp>
 #include <range/v3/view/drop.hpp>
-#include <range/v3/view/take.hpp>
-#include <range/v3/view/zip_with.hpp>
 
 #include <range/v3/algorithm/rotate.hpp>
-#include <range/v3/algorithm/fold.hpp>
-
-#include <BS_thread_pool.hpp>
 
 
 namespace rg = ranges;
 namespace vw = ranges::views;
 
-std::vector<int> random_matrix(std::size_t N) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dist(-10, 10);
-
-    std::vector<int> mat;
-    mat.reserve(N * N);
-
-    for (std::size_t i = 0; i < N*N; ++i) {
-        mat.emplace_back(dist(gen));
-    }
-
-    return mat;
-}
-
-std::vector<int> deserealize(std::size_t N) {
-    spdlog::info("input matrix ({}x{}):", N, N);
-    
-    std::vector<int> m;
-    m.reserve(N*N);
-    for (std::size_t i = 0; i < N * N; ++i) {
-        int x; std::cin >> x;
-        m.emplace_back(x);
-    }
-    return m;
-}
-
-std::string serialize(std::vector<int> const & m, std::size_t N) {
-    std::string res;
-    for (auto const row : m | vw::chunk(N)) {
-        res += fmt::format("{:3}\n", fmt::join(row, ", "));
-    }
-    return fmt::format("[\n{}]", res);
-}
+namespace {
 
-void block_row_shift(std::vector<int>& m, std::size_t N, std::size_t bs, std::size_t row, std::size_t shift_blocks) {
+template <typename T>
+void block_row_shift(std::vector<T>& m, std::size_t N, std::size_t bs, std::size_t row, std::size_t shift_blocks) {
     for (int i = 0; i < bs; ++i) {
         const auto shift = shift_blocks * bs;
         auto row_start = m.begin() + (row * bs + i) * N; // i-th row of block
@@ -68,7 +37,8 @@ void block_row_shift(std::vector<int>& m, std::size_t N, std::size_t bs, std::si
     }    
 }
 
-void block_col_shift(std::vector<int>& m, std::size_t N, std::size_t bs, std::size_t col, std::size_t shift_blocks) {
+template <typename T>
+void block_col_shift(std::vector<T>& m, std::size_t N, std::size_t bs, std::size_t col, std::size_t shift_blocks) {
     for (int i = 0; i < bs; ++i) {
         auto t = m | vw::drop(col * bs + i) | vw::stride(N);
         const auto shift = shift_blocks * bs;
@@ -76,118 +46,250 @@ void block_col_shift(std::vector<int>& m, std::size_t N, std::size_t bs, std::si
     }    
 }
 
-void initial_row_shift(std::vector<int>& m, std::size_t N, std::size_t bs) {
+template <typename T>
+void initial_row_shift(std::vector<T>& m, std::size_t N, std::size_t bs) {
     const auto n_blocks = N / bs;
     for (std::size_t row = 0; row < n_blocks; ++row) {
         block_row_shift(m, N, bs, row, row);
     }
 }
 
-void initial_col_shift(std::vector<int>& m, std::size_t N, std::size_t bs) {
+template <typename T>
+void initial_col_shift(std::vector<T>& m, std::size_t N, std::size_t bs) {
     const auto n_blocks = N / bs;
     for (std::size_t col = 0; col < n_blocks; ++col) {
         block_col_shift(m, N, bs, col, col);
     }
 }
 
-void row_shift(std::vector<int>& m, std::size_t N, std::size_t bs, std::size_t shift_blocks) {
+template <typename T>
+void row_shift(std::vector<T>& m, std::size_t N, std::size_t bs, std::size_t shift_blocks) {
     const auto n_blocks = N / bs;
     for (std::size_t row = 0; row < n_blocks; ++row) {
         block_row_shift(m, N, bs, row, shift_blocks);
     }
 }
 
-void col_shift(std::vector<int>& m, std::size_t N, std::size_t bs, std::size_t shift_blocks) {
+template <typename T>
+void col_shift(std::vector<T>& m, std::size_t N, std::size_t bs, std::size_t shift_blocks) {
     const auto n_blocks = N / bs;
     for (std::size_t col = 0; col < n_blocks; ++col) {
         block_col_shift(m, N, bs, col, shift_blocks);
     }
 }
 
-void block_mul(std::vector<int>& A, std::vector<int>& B, std::vector<int>& C, std::size_t row, std::size_t col, std::size_t N, std::size_t bs) {
-    const auto rb = row * bs;
-    const auto cb = col * bs;
-    for (std::size_t i = 0; i < bs; ++i) {
-        for (std::size_t j = 0; j < bs; ++j) {
-            auto row_range = A | vw::drop(N * (rb + i) + cb) | vw::take(bs);
-            auto col_range = B | vw::drop(N * rb + cb + j) | vw::stride(N) | vw::take(bs);
-            // spdlog::info("A_{}_{} ({}, {}): {}", row, col, i, j, fmt::join(row_range, " "));
-            // spdlog::info("B_{}_{} ({}, {}): {}\n", row, col, i, j, fmt::join(col_range, " "));
+template <typename T>
+void block_mul(std::vector<T>& A, std::vector<T>& B, std::vector<T>& C, std::size_t row, std::size_t col, std::size_t N, std::size_t bs) {
+    const auto offset = N * row * bs + col * bs;
+    block_gemm(A.data() + offset, N, B.data() + offset, N, C.data() + offset, N, bs, bs, bs);
+}
 
-            auto res = rg::fold_left_first(
-                vw::zip_with(std::multiplies{}, row_range, col_range),
-                std::plus{}
-            );
-            C[N * (rb + i) + cb + j] += res.value();
+// [begin, end) of the part-th of n_parts near-equal slices of [0, n)
+std::pair<std::size_t, std::size_t> slice(std::size_t n, std::size_t n_parts, std::size_t part)
+{
+    const auto base = n / n_parts;
+    const auto extra = n % n_parts;
+    const auto begin = part * base + std::min(part, extra);
+    return {begin, begin + base + (part < extra ? 1 : 0)};
+}
+
+// Every worker of the rows x cols grid owns a rectangle of C tiles; run f(row, col) over all of them and wait
+template <typename F>
+void for_each_tile(thread_pool & pool, cannon_grid grid, std::size_t n_blocks, F && f)
+{
+    std::vector<task_future<void>> futures;
+    for (std::size_t pr = 0; pr < grid.rows; ++pr) {
+        for (std::size_t pc = 0; pc < grid.cols; ++pc) {
+            const auto [row_start, row_end] = slice(n_blocks, grid.rows, pr);
+            const auto [col_start, col_end] = slice(n_blocks, grid.cols, pc);
+            if (row_start == row_end || col_start == col_end) {
+                continue;
+            }
+            futures.emplace_back(pool.submit_task([&, row_start, row_end, col_start, col_end]{
+                LABS_TRACE_SCOPE("block_mul");
+                for (std::size_t row = row_start; row < row_end; ++row) {
+                    for (std::size_t col = col_start; col < col_end; ++col) {
+                        f(row, col);
+                    }
+                }
+            }));
+        }
+    }
+    LABS_TRACE_COUNT(tasks, futures.size());
+    join_all(futures);
+}
+
+// Grid of tile indices over a row-major N x N matrix cut into bs x bs tiles (the last row and column
+// of tiles may be narrower). The tiles stay where they are (block_gemm packs its operands anyway),
+// so a Cannon shift permutes indices instead of moving data. Position (row, col) multiplies A tile
+// (row, k) by B tile (k, col), and k is all the grid stores: the skews of A and B are equal, and so
+// are a row shift of A's indices and a column shift of B's, so one grid serves both operands.
+struct tile_grid
+{
+    std::size_t n_blocks;
+    std::vector<std::size_t> grid; // grid position (row, col) holds k = grid[row * n_blocks + col]
+
+    explicit tile_grid(std::size_t n_blocks)
+        : n_blocks{n_blocks}
+        , grid(n_blocks * n_blocks)
+    {}
+
+    std::size_t & operator()(std::size_t row, std::size_t col) { return grid[row * n_blocks + col]; }
+    std::size_t operator()(std::size_t row, std::size_t col) const { return grid[row * n_blocks + col]; }
+};
+
+// Skewed operands: position (row, col) holds k = row + col
+tile_grid skewed_tiles(std::size_t n_blocks) {
+    tile_grid t(n_blocks);
+    for (std::size_t row = 0; row < n_blocks; ++row) {
+        for (std::size_t col = 0; col < n_blocks; ++col) {
+            t(row, col) = (row + col) % n_blocks;
         }
     }
+    return t;
 }
 
-void cannon_multiply(std::vector<int> & A, std::vector<int> & B, std::vector<int> & C, std::size_t N, std::size_t block_size, std::size_t n_workers)
+void tile_row_shift(tile_grid & t, std::size_t row, std::size_t shift_blocks) {
+    auto row_start = t.grid.begin() + row * t.n_blocks;
+    std::rotate(row_start, row_start + shift_blocks % t.n_blocks, row_start + t.n_blocks);
+}
+
+// Reference schedule: the skew and every per-step shift rotate whole rows and strided columns in place.
+// Rotations need whole tiles, so the private copies of A, B and C are zero-padded up to a multiple of bs.
+template <typename T>
+void cannon_multiply_reference(std::span<T const> A_in, std::span<T const> B_in, std::span<T> C_out, std::size_t N, std::size_t block_size, thread_pool & pool, cannon_grid grid)
 {
-    if (N % block_size != 0) {
-        spdlog::error("Matrix is not dividable into blocks: N={} block_size={}", N, block_size);
-        std::terminate();
+    const auto n_blocks = (N + block_size - 1) / block_size;
+    const auto P = n_blocks * block_size;
+
+    auto pad = [&](std::span<T const> m) {
+        std::vector<T> padded(P * P, T{});
+        for (std::size_t i = 0; i < N; ++i) {
+            std::copy_n(m.begin() + i * N, N, padded.begin() + i * P);
+        }
+        return padded;
+    };
+    auto A = pad(A_in);
+    auto B = pad(B_in);
+    std::vector<T> C(P * P, T{});
+
+    {
+        LABS_TRACE_SCOPE("skew");
+        initial_row_shift(A, P, block_size);
+        initial_col_shift(B, P, block_size);
+        LABS_TRACE_COUNT(bytes, 2 * P * P * sizeof(T));
     }
 
-    const auto n_blocks = N / block_size;
+    for (std::size_t i = 0; i < n_blocks; ++i) {
+        LABS_TRACE_SCOPE_ARG("step", i);
+        for_each_tile(pool, grid, n_blocks, [&](std::size_t row, std::size_t col) {
+            block_mul(A, B, C, row, col, P, block_size);
+        });
+
+        LABS_TRACE_SCOPE("shift");
+        row_shift(A, P, block_size, 1);
+        col_shift(B, P, block_size, 1);
+        LABS_TRACE_COUNT(bytes, 2 * P * P * sizeof(T));
+    }
 
-    const auto blocks_per_worker = n_blocks / n_workers;
-    const auto blocks_per_worker_remainder = blocks_per_worker + n_blocks % n_workers;
+    for (std::size_t i = 0; i < N; ++i) {
+        std::copy_n(C.begin() + i * P, N, C_out.begin() + i * N);
+    }
+}
 
-    spdlog::info("Create threadpool with {} workers", n_workers);
-    BS::thread_pool pool(n_workers);
+// Tiled schedule: the operands are never copied or moved, shifts only rotate the tile grid.
+// Edge tiles are simply smaller: the k extent of a product is the extent of the shared tile index.
+template <typename T>
+void cannon_multiply_tiled(std::span<T const> A, std::span<T const> B, std::span<T> C, std::size_t N, std::size_t block_size, thread_pool & pool, cannon_grid grid)
+{
+    const auto n_blocks = (N + block_size - 1) / block_size;
+    auto extent = [&](std::size_t tile) { return std::min(block_size, N - tile * block_size); };
 
-    initial_row_shift(A, N, block_size);
-    initial_col_shift(B, N, block_size);
+    auto tiles = skewed_tiles(n_blocks);
 
     for (std::size_t i = 0; i < n_blocks; ++i) {
-        std::vector<std::future<void>> futures;
-        for (std::size_t worker = 0; worker < n_workers; ++worker) {
-            futures.emplace_back(pool.submit_task([&, worker]{
-                const auto row_start = worker * blocks_per_worker;
-                const auto row_end = row_start + (worker == n_workers - 1 ? blocks_per_worker_remainder : blocks_per_worker);
-                for (std::size_t row = row_start; row < row_end; ++row) {
-                    for (std::size_t col = 0; col < n_blocks; ++col) {
-                        block_mul(A, B, C, row, col, N, block_size);
-                    }
-                }
-            }));
-        }
-        for (auto const & f : futures) {
-            f.wait();
+        LABS_TRACE_SCOPE_ARG("step", i);
+        for_each_tile(pool, grid, n_blocks, [&](std::size_t row, std::size_t col) {
+            const auto k = tiles(row, col);
+            T const * a = A.data() + row * block_size * N + k * block_size;
+            T const * b = B.data() + k * block_size * N + col * block_size;
+            T * c = C.data() + row * block_size * N + col * block_size;
+            block_gemm<T>(a, N, b, N, c, N, extent(row), extent(col), extent(k));
+        });
+
+        LABS_TRACE_SCOPE("shift");
+        for (std::size_t row = 0; row < n_blocks; ++row) {
+            tile_row_shift(tiles, row, 1);
         }
-
-        row_shift(A, N, block_size, 1);
-        col_shift(B, N, block_size, 1);
     }
 }
 
-std::vector<int> cannon_matmul(std::size_t N, std::size_t n_workers) {
-    auto A = deserealize(N);
-    auto B = deserealize(N);
-    auto C = std::vector(N*N, 0);
+// Three tiles (A, B and the C accumulator) of one step should share the per-core L2,
+// and there should be at least one tile per worker along each grid dimension.
+std::size_t auto_block_size(std::size_t N, std::size_t elem_size, cannon_grid grid)
+{
+    std::size_t l2 = 0;
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+    const auto l2_conf = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    l2 = l2_conf > 0 ? static_cast<std::size_t>(l2_conf) : 0;
+#endif
+    if (l2 == 0) {
+        l2 = 512 * 1024;
+    }
 
-    spdlog::info("A = {}", serialize(A, N));
-    spdlog::info("B = {}", serialize(B, N));
+    auto bs = static_cast<std::size_t>(std::sqrt(static_cast<double>(l2) / (3 * elem_size)));
+    bs = std::max<std::size_t>(bs / 16 * 16, 16);
 
-    std::size_t block_size = N / n_workers;
+    const auto per_worker = (N + std::max(grid.rows, grid.cols) - 1) / std::max(grid.rows, grid.cols);
+    return std::clamp<std::size_t>(std::min(bs, per_worker), 1, std::max<std::size_t>(N, 1));
+}
 
-    const auto start = std::chrono::high_resolution_clock::now();
-    cannon_multiply(A, B, C, N, block_size, n_workers);
-    const auto finish = std::chrono::high_resolution_clock::now();
-    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count();
+} // namespace
 
-    spdlog::info("C = {}", serialize(C, N));
-    spdlog::info("elapsed {}ms for N={} workers={}", elapsed, N, n_workers);
-    spdlog::info("physical cores = {}", std::thread::hardware_concurrency());
+cannon_grid make_cannon_grid(std::size_t n_workers)
+{
+    n_workers = std::max<std::size_t>(n_workers, 1);
+    auto rows = static_cast<std::size_t>(std::sqrt(static_cast<double>(n_workers)));
+    while (n_workers % rows != 0) {
+        --rows;
+    }
+    return {rows, n_workers / rows};
+}
 
-    return C;
+std::size_t cannon_block_size(std::size_t N, std::size_t elem_size, std::size_t block_size, std::size_t n_workers)
+{
+    if (block_size == 0) {
+        block_size = auto_block_size(N, elem_size, make_cannon_grid(n_workers));
+    }
+    return std::min(block_size, N);
 }
 
-int main(int argc, char** argv)
+template <typename T>
+void cannon_multiply(std::span<T const> A, std::span<T const> B, std::span<T> C, std::size_t N, std::size_t block_size, std::size_t n_workers, cannon_shift shift)
 {
-    const std::size_t N = std::stoull(argv[1]);
-    const std::size_t n_workers = std::stoull(argv[2]);
-    cannon_matmul(N, n_workers);
+    if (A.size() < N * N || B.size() < N * N || C.size() < N * N) {
+        throw std::invalid_argument(fmt::format("cannon_multiply: operands are smaller than {}x{}", N, N));
+    }
+    if (N == 0) {
+        return;
+    }
+
+    const auto grid = make_cannon_grid(n_workers);
+    block_size = cannon_block_size(N, sizeof(T), block_size, n_workers);
+    auto & pool = persistent_pool(grid.rows * grid.cols);
+
+    std::fill(C.begin(), C.begin() + N * N, T{});
+    LABS_TRACE_COUNT(elements, N * N);
+
+    if (shift == cannon_shift::reference) {
+        cannon_multiply_reference(A, B, C, N, block_size, pool, grid);
+    }
+    else {
+        cannon_multiply_tiled(A, B, C, N, block_size, pool, grid);
+    }
 }
+
+template void cannon_multiply<int>(std::span<int const>, std::span<int const>, std::span<int>, std::size_t, std::size_t, std::size_t, cannon_shift);
+template void cannon_multiply<std::int64_t>(std::span<std::int64_t const>, std::span<std::int64_t const>, std::span<std::int64_t>, std::size_t, std::size_t, std::size_t, cannon_shift);
+template void cannon_multiply<float>(std::span<float const>, std::span<float const>, std::span<float>, std::size_t, std::size_t, std::size_t, cannon_shift);
+template void cannon_multiply<double>(std::span<double const>, std::span<double const>, std::span<double>, std::size_t, std::size_t, std::size_t, cannon_shift);
@@ -0,0 +1,178 @@
+#include <cannon.hpp>
+#include <gemm.hpp>
+#include <matrix_io.hpp>
+#include <thread_pool.hpp>
+#include <trace.hpp>
+
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/ranges.h>
+
+#include <range/v3/view/chunk.hpp>
+
+
+namespace fs = std::filesystem;
+namespace vw = ranges::views;
+
+std::vector<int> random_matrix(std::size_t N) {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<int> dist(-10, 10);
+
+    std::vector<int> mat;
+    mat.reserve(N * N);
+
+    for (std::size_t i = 0; i < N*N; ++i) {
+        mat.emplace_back(dist(gen));
+    }
+
+    return mat;
+}
+
+std::vector<int> deserealize(std::size_t N) {
+    spdlog::info("input matrix ({}x{}):", N, N);
+    
+    std::vector<int> m;
+    m.reserve(N*N);
+    for (std::size_t i = 0; i < N * N; ++i) {
+        int x; std::cin >> x;
+        m.emplace_back(x);
+    }
+    return m;
+}
+
+std::string serialize(std::span<int const> m, std::size_t N) {
+    std::string res;
+    for (auto const row : m | vw::chunk(N)) {
+        res += fmt::format("{:3}\n", fmt::join(row, ", "));
+    }
+    return fmt::format("[\n{}]", res);
+}
+
+struct cannon_options
+{
+    cannon_shift shift = cannon_shift::tiles;
+    std::optional<fs::path> a_path;   // binary inputs, memory-mapped; stdin text when unset
+    std::optional<fs::path> b_path;
+    std::optional<fs::path> out_path; // binary output
+    std::optional<fs::path> dump_a_path; // binary copies of the inputs, whatever their source
+    std::optional<fs::path> dump_b_path;
+    bool random = false;              // generate A and B instead of reading them
+    bool print = false;               // log A, B and C as text
+};
+
+std::vector<int> cannon_matmul(std::size_t N, std::size_t n_workers, cannon_options const & opts) {
+    std::optional<mapped_matrix<int>> A_file, B_file;
+    std::vector<int> A_text, B_text;
+    std::span<int const> A, B;
+
+    const auto load_start = std::chrono::high_resolution_clock::now();
+    if (opts.a_path && opts.b_path) {
+        A_file.emplace(*opts.a_path);
+        B_file.emplace(*opts.b_path);
+        for (auto const * m : {&*A_file, &*B_file}) {
+            if (m->rows() != N || m->cols() != N) {
+                throw std::runtime_error(fmt::format("expected a {}x{} matrix, got {}x{}", N, N, m->rows(), m->cols()));
+            }
+        }
+        A = A_file->data();
+        B = B_file->data();
+    }
+    else {
+        A_text = opts.random ? random_matrix(N) : deserealize(N);
+        B_text = opts.random ? random_matrix(N) : deserealize(N);
+        A = A_text;
+        B = B_text;
+    }
+    const auto load_finish = std::chrono::high_resolution_clock::now();
+    spdlog::info("input loaded in {}ms", std::chrono::duration_cast<std::chrono::milliseconds>(load_finish - load_start).count());
+
+    if (opts.dump_a_path && opts.dump_b_path) {
+        write_matrix<int>(*opts.dump_a_path, A, N, N);
+        write_matrix<int>(*opts.dump_b_path, B, N, N);
+        spdlog::info("A and B written to {} and {}", opts.dump_a_path->string(), opts.dump_b_path->string());
+    }
+
+    auto C = std::vector(N*N, 0);
+
+    if (opts.print) {
+        spdlog::info("A = {}", serialize(A, N));
+        spdlog::info("B = {}", serialize(B, N));
+    }
+
+    const auto grid = make_cannon_grid(n_workers);
+    const auto block_size = cannon_block_size(N, sizeof(int), 0, n_workers);
+    spdlog::info("Run on {} pool with {} workers ({}x{} grid), block size: {}, block kernel: {}, shift: {}",
+        thread_pool_name, grid.rows * grid.cols, grid.rows, grid.cols, block_size, gemm_isa_name(detect_gemm_isa()), cannon_shift_name(opts.shift));
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    cannon_multiply<int>(A, B, C, N, block_size, n_workers, opts.shift);
+    const auto finish = std::chrono::high_resolution_clock::now();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count();
+    const auto gflops = 2.0 * N * N * N / std::chrono::duration<double>(finish - start).count() / 1e9;
+
+    if (opts.print) {
+        spdlog::info("C = {}", serialize(C, N));
+    }
+    if (opts.out_path) {
+        const auto write_start = std::chrono::high_resolution_clock::now();
+        write_matrix<int>(*opts.out_path, C, N, N);
+        const auto write_finish = std::chrono::high_resolution_clock::now();
+        spdlog::info("C written to {} in {}ms", opts.out_path->string(), std::chrono::duration_cast<std::chrono::milliseconds>(write_finish - write_start).count());
+    }
+    spdlog::info("elapsed {}ms for N={} workers={} ({:.2f} GFLOP/s)", elapsed, N, n_workers, gflops);
+    spdlog::info("physical cores = {}", std::thread::hardware_concurrency());
+
+    return C;
+}
+
+int main(int argc, char** argv)
+{
+    LABS_TRACE_SESSION("cannon");
+    const std::size_t N = std::stoull(argv[1]);
+    const std::size_t n_workers = std::stoull(argv[2]);
+
+    cannon_options opts;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "reference") {
+            opts.shift = cannon_shift::reference;
+        }
+        else if (arg == "--print") {
+            opts.print = true;
+        }
+        else if (arg == "--random") {
+            opts.random = true;
+        }
+        else if (arg == "--in" && i + 2 < argc) {
+            opts.a_path = argv[++i];
+            opts.b_path = argv[++i];
+        }
+        else if (arg == "--out" && i + 1 < argc) {
+            opts.out_path = argv[++i];
+        }
+        else if (arg == "--dump" && i + 2 < argc) {
+            opts.dump_a_path = argv[++i];
+            opts.dump_b_path = argv[++i];
+        }
+        else {
+            spdlog::error("unknown argument: {}", arg);
+            return 1;
+        }
+    }
+
+    try {
+        cannon_matmul(N, n_workers, opts);
+    }
+    catch (std::exception const & e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+}
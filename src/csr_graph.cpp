@@ -0,0 +1,162 @@
+#include <csr_graph.hpp>
+#include <mapped_file.hpp>
+#include <parallel_reduce.hpp>
+#include <trace.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Frontier vertices per chunk below which splitting a level further doesn't pay off
+constexpr std::size_t chunk_grain = 1024;
+
+// Chunks per pool thread, so a few high-degree vertices don't leave the other workers idle
+constexpr std::size_t chunks_per_thread = 4;
+
+class visited_bitmap
+{
+public:
+    explicit visited_bitmap(std::size_t n) : words_((n + 63) / 64) {}
+
+    // True for exactly one caller per vertex; the plain load skips the atomic RMW for vertices already seen
+    bool claim(std::uint32_t v)
+    {
+        auto & word = words_[v / 64];
+        const auto bit = std::uint64_t{1} << (v % 64);
+        if (word.load(std::memory_order_relaxed) & bit) {
+            return false;
+        }
+        return !(word.fetch_or(bit, std::memory_order_relaxed) & bit);
+    }
+
+private:
+    std::vector<std::atomic<std::uint64_t>> words_;
+};
+
+class token_reader
+{
+public:
+    explicit token_reader(std::string_view text) : text_{text}, p_{text.data()} {}
+
+    template <typename T>
+    T next()
+    {
+        const char * end = text_.data() + text_.size();
+        while (p_ != end && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) ++p_;
+
+        T value;
+        const auto [next, ec] = std::from_chars(p_, end, value);
+        if (ec != std::errc{}) {
+            throw std::runtime_error("malformed number at byte " + std::to_string(p_ - text_.data()));
+        }
+        p_ = next;
+        return value;
+    }
+
+private:
+    std::string_view text_;
+    const char * p_;
+};
+
+} // namespace
+
+csr_graph make_csr(std::vector<int> values, std::span<edge const> edges)
+{
+    csr_graph g;
+    g.values = std::move(values);
+    g.offsets.assign(g.size() + 1, 0);
+
+    for (auto const & [u, v] : edges) {
+        ++g.offsets[u + 1];
+        ++g.offsets[v + 1];
+    }
+    for (std::size_t v = 0; v < g.size(); ++v) {
+        g.offsets[v + 1] += g.offsets[v];
+    }
+
+    g.targets.resize(g.offsets.back());
+    std::vector<std::uint64_t> fill(g.offsets.begin(), g.offsets.end() - 1);
+    for (auto const & [u, v] : edges) {
+        g.targets[fill[u]++] = v;
+        g.targets[fill[v]++] = u;
+    }
+    return g;
+}
+
+csr_graph load_graph(std::filesystem::path const & path)
+{
+    const mapped_file file{path};
+    file.advise_sequential();
+
+    token_reader in{file.text()};
+    const auto n_vertices = in.next<std::uint32_t>();
+    const auto n_edges = in.next<std::uint64_t>();
+
+    std::vector<int> values(n_vertices);
+    for (auto & v : values) {
+        v = in.next<int>();
+    }
+
+    std::vector<edge> edges(n_edges);
+    for (auto & [u, v] : edges) {
+        u = in.next<std::uint32_t>();
+        v = in.next<std::uint32_t>();
+        if (u >= n_vertices || v >= n_vertices) {
+            throw std::runtime_error("edge " + std::to_string(u) + " " + std::to_string(v) + " is out of range");
+        }
+    }
+    return make_csr(std::move(values), edges);
+}
+
+void level_bfs(thread_pool & pool, csr_graph const & graph, std::uint32_t source,
+    std::function<void(std::size_t, std::span<std::uint32_t const>)> const & on_level)
+{
+    if (source >= graph.size()) {
+        throw std::invalid_argument("bfs source " + std::to_string(source) + " is not a vertex");
+    }
+
+    visited_bitmap visited(graph.size());
+    visited.claim(source);
+
+    const auto max_chunks = pool.get_thread_count() * chunks_per_thread;
+    std::vector<padded<std::vector<std::uint32_t>>> local(max_chunks);
+    std::vector<std::size_t> offsets(max_chunks + 1);
+
+    std::vector<std::uint32_t> frontier{source};
+    std::vector<std::uint32_t> next;
+
+    for (std::size_t level = 0; !frontier.empty(); ++level) {
+        on_level(level, frontier);
+
+        LABS_TRACE_SCOPE_ARG("expand", level);
+        const auto n = frontier.size();
+        const auto n_chunks = std::clamp<std::size_t>(n / chunk_grain, 1, max_chunks);
+
+        run_tasks(pool, n_chunks, [&](std::size_t c) {
+            auto & out = local[c].value;
+            out.clear();
+            for (auto i = n * c / n_chunks; i < n * (c + 1) / n_chunks; ++i) {
+                for (const auto u : graph.neighbours(frontier[i])) {
+                    if (visited.claim(u)) {
+                        out.push_back(u);
+                    }
+                }
+            }
+        });
+
+        for (std::size_t c = 0; c < n_chunks; ++c) {
+            offsets[c + 1] = offsets[c] + local[c].value.size();
+        }
+
+        next.resize(offsets[n_chunks]);
+        run_tasks(pool, n_chunks, [&](std::size_t c) {
+            std::copy(local[c].value.begin(), local[c].value.end(), next.begin() + offsets[c]);
+        });
+
+        frontier.swap(next);
+    }
+}
@@ -4,79 +4,212 @@
 #include <fstream>
 #include <span>
 #include <algorithm>
-#include <bitset>
+#include <cctype>
+#include <charconv>
+#include <iterator>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
 
 #include <spdlog/spdlog.h>
 
-#include <BS_thread_pool.hpp>
-
 #include <gmpxx.h>
 
-// mpz_class fib(std::size_t N, std::size_t n_workers)
-// {
-//     if (N == 1) return 1;
-//     if (N == 2) return 1;
+#include <big_decimal.hpp>
+#include <fibonacci.hpp>
+#include <thread_pool.hpp>
+#include <trace.hpp>
+
+// Numbers up to this many digits are printed in full unless --print says otherwise
+constexpr std::size_t max_default_print_digits = 10000;
+
+// Digit count plus leading and trailing digits, without converting the whole number:
+// one division and one remainder by powers of ten
+std::string decimal_summary(mpz_class const & x)
+{
+    constexpr unsigned long edge = 20;
+
+    const auto max_digits = mpz_sizeinbase(x.get_mpz_t(), 10);
+    if (max_digits <= 2 * edge) {
+        return x.get_str();
+    }
 
-//     BS::thread_pool pool(n_workers);
+    mpz_class scale;
+    mpz_ui_pow_ui(scale.get_mpz_t(), 10, max_digits - edge);
+    const mpz_class head = x / scale;
+    const auto head_str = head.get_str();
 
-//     std::vector<mpz_class> memo{-1, 1, 1};
-//     memo.reserve(N);
+    mpz_ui_pow_ui(scale.get_mpz_t(), 10, edge);
+    const mpz_class tail = x % scale;
+    auto tail_str = tail.get_str();
+    tail_str.insert(0, edge - tail_str.size(), '0');
 
-//     for (std::size_t i = 3; i <= N; ++i) {
-//         mpz_class f = memo[i - 1] + memo[i - 2];
-//         memo.emplace_back(std::move(f));
-//     }
+    return fmt::format("{}...{} ({} digits)", head_str, tail_str, max_digits - edge + head_str.size());
+}
 
-//     return memo.back();
-// }
+std::uint64_t fnv1a(std::string_view s)
+{
+    std::uint64_t h = 14695981039346656037ull;
+    for (const unsigned char c : s) {
+        h = (h ^ c) * 1099511628211ull;
+    }
+    return h;
+}
 
-std::string dec_to_bin(std::size_t n)
+template <typename F>
+long long time_ms(F && f)
 {
-    std::string bin = std::bitset<sizeof(std::size_t) * 8>(n).to_string();
-    auto loc = bin.find('1');
+    const auto start = std::chrono::high_resolution_clock::now();
+    f();
+    const auto finish = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count();
+}
 
-    if (loc != std::string::npos)
-        return bin.substr(loc);
-    return "0";
+void write_file(std::string const & path, char const * data, std::size_t size)
+{
+    std::ofstream file{path, std::ios::binary};
+    file.write(data, static_cast<std::streamsize>(size));
+    if (!file) {
+        throw std::runtime_error(fmt::format("failed to write {}", path));
+    }
 }
 
-mpz_class fib(std::size_t N, std::size_t n_workers) {
-    BS::thread_pool pool(n_workers);
-
-    auto bin_of_n = dec_to_bin(N);
- 
-    mpz_class f[] = { 0, 1 }; // [F(i), F(i+1)] => i=0
- 
-    for (auto b : bin_of_n) {
-        auto f1s_task = pool.submit_task([&]{ mpz_class f1s = f[1] * f[1]; return f1s; }); // F(1)^2
-        auto f0s_task = pool.submit_task([&]{ mpz_class f0s = f[0] * f[0]; return f0s; }); // F(0)^2
-
-        auto df1mf0_task = pool.submit_task([&]{ mpz_class res = 2 * f[1] - f[0]; return res; }); // 2 * f[1] - f[0]
-
-        auto f2i1_task = pool.submit_task([&]{ mpz_class f2i1 = f0s_task.get() + f1s_task.get(); return f2i1; }); // F(2i+1)
-        auto f2i_task = pool.submit_task([&]{ mpz_class f2i = f[0] * df1mf0_task.get(); return f2i; });   // F(2i+1)
-        
-        mpz_class f2i1 = f2i1_task.get();
-        mpz_class f2i = f2i_task.get();
- 
-        if (b == '0') {
-            f[0] = std::move(f2i); // F(2i)
-            f[1] = std::move(f2i1); // F(2i+1)
+// Query indices separated by whitespace or commas
+std::vector<std::size_t> read_queries(std::string const & path)
+{
+    std::ifstream file{path};
+    if (!file) {
+        throw std::runtime_error(fmt::format("failed to open {}", path));
+    }
+    const std::string text{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    std::vector<std::size_t> queries;
+    const char * p = text.data();
+    const char * end = text.data() + text.size();
+    while (true) {
+        while (p != end && (*p == ',' || std::isspace(static_cast<unsigned char>(*p)))) ++p;
+        if (p == end) break;
+
+        std::size_t n;
+        const auto [next, ec] = std::from_chars(p, end, n);
+        if (ec != std::errc{}) {
+            throw std::runtime_error(fmt::format("malformed query at byte {} of {}", p - text.data(), path));
         }
-        else {
-            f[1] = f2i1 + f2i; // F(2i+2)
-            f[0] = std::move(f2i1); // F(2i+1)
+        queries.push_back(n);
+        p = next;
+    }
+    return queries;
+}
+
+int run_batch(std::vector<std::size_t> queries, std::size_t n_workers, std::string print_mode, std::string const & out_path)
+{
+    spdlog::info("Find {} fibonacci numbers with {} workers", queries.size(), n_workers);
+
+    std::vector<std::pair<std::size_t, mpz_class>> results;
+    const auto elapsed = time_ms([&]{ results = fib_batch(std::move(queries), n_workers); });
+
+    if (print_mode.empty()) {
+        print_mode = !results.empty() && mpz_sizeinbase(results.back().second.get_mpz_t(), 10) <= max_default_print_digits ? "full" : "summary";
+    }
+
+    std::ofstream out;
+    if (!out_path.empty()) {
+        out.open(out_path, std::ios::binary);
+    }
+
+    const auto output_elapsed = time_ms([&]{
+        for (auto const & [n, f] : results) {
+            std::string decimal;
+            if (print_mode == "full" || print_mode == "hash" || out.is_open()) {
+                decimal = to_decimal(persistent_pool(n_workers), f);
+            }
+
+            if (print_mode == "full") {
+                spdlog::info("{}th fibonacci number is {}", n, decimal);
+            }
+            else if (print_mode == "summary") {
+                spdlog::info("{}th fibonacci number is {}", n, decimal_summary(f));
+            }
+            else if (print_mode == "hash") {
+                spdlog::info("{}th fibonacci number has {} digits, fnv1a {:016x}", n, decimal.size(), fnv1a(decimal));
+            }
+
+            if (out.is_open()) {
+                out << n << ' ' << decimal << '\n';
+            }
         }
+    });
+    if (out.is_open() && !out) {
+        throw std::runtime_error(fmt::format("failed to write {}", out_path));
     }
- 
-    return f[0];
+
+    spdlog::info("output: {}ms", output_elapsed);
+    spdlog::info("elapsed: {}ms {} workers ({} distinct queries)", elapsed, n_workers, results.size());
+    spdlog::info("{} hw cores", std::thread::hardware_concurrency());
+    return 0;
 }
 
 int main(int argc, char** argv)
 {
-    const std::size_t N = std::stoull(argv[1]);
+    LABS_TRACE_SESSION("fib");
+    const bool batch = std::string_view{argv[1]} == "batch";
+    const std::size_t N = batch ? 0 : std::stoull(argv[1]);
     const std::size_t n_workers = std::stoull(argv[2]);
 
+    std::string print_mode;
+    std::string out_path;
+    std::string raw_path;
+    std::string queries_path;
+    std::vector<std::size_t> queries;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (batch && arg == "--in" && i + 1 < argc) {
+            queries_path = argv[++i];
+        }
+        else if (batch && arg == "--range" && i + 2 < argc) {
+            const std::size_t first = std::stoull(argv[++i]);
+            const std::size_t last = std::stoull(argv[++i]);
+            const std::size_t stride = i + 1 < argc && argv[i + 1][0] != '-' ? std::stoull(argv[++i]) : 1;
+            for (auto n = first; n <= last && stride != 0; n += stride) {
+                queries.push_back(n);
+            }
+        }
+        else if (arg == "--print" && i + 1 < argc) {
+            print_mode = argv[++i];
+        }
+        else if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        }
+        else if (arg == "--raw" && i + 1 < argc) {
+            raw_path = argv[++i];
+        }
+        else {
+            spdlog::error("unknown argument: {}", arg);
+            return 1;
+        }
+    }
+    if (!print_mode.empty() && print_mode != "full" && print_mode != "summary" && print_mode != "hash" && print_mode != "none") {
+        spdlog::error("unknown print mode: {} (full, summary, hash or none)", print_mode);
+        return 1;
+    }
+
+    if (batch) {
+        try {
+            if (!queries_path.empty()) {
+                auto more = read_queries(queries_path);
+                queries.insert(queries.end(), more.begin(), more.end());
+            }
+            if (!raw_path.empty()) {
+                throw std::runtime_error("--raw is not supported in batch mode");
+            }
+            return run_batch(std::move(queries), n_workers, print_mode, out_path);
+        }
+        catch (std::exception const & e) {
+            spdlog::error("{}", e.what());
+            return 1;
+        }
+    }
+
     spdlog::info("Find {}th fibonacci number with {} workers", N, n_workers);
 
     const auto start = std::chrono::high_resolution_clock::now();
@@ -86,7 +219,45 @@ int main(int argc, char** argv)
     const auto finish = std::chrono::high_resolution_clock::now();
     const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count();
 
-    spdlog::info("{}th fibonacci number is {}", N, f.get_str());
+    if (print_mode.empty()) {
+        print_mode = mpz_sizeinbase(f.get_mpz_t(), 10) <= max_default_print_digits ? "full" : "summary";
+    }
+
+    try {
+        std::string decimal;
+        if (print_mode == "full" || print_mode == "hash" || !out_path.empty()) {
+            const auto convert_elapsed = time_ms([&]{ decimal = to_decimal(persistent_pool(n_workers), f); });
+            spdlog::info("decimal conversion: {}ms ({} digits)", convert_elapsed, decimal.size());
+        }
+
+        if (print_mode == "full") {
+            spdlog::info("{}th fibonacci number is {}", N, decimal);
+        }
+        else if (print_mode == "summary") {
+            spdlog::info("{}th fibonacci number is {}", N, decimal_summary(f));
+        }
+        else if (print_mode == "hash") {
+            spdlog::info("{}th fibonacci number has {} digits, fnv1a {:016x}", N, decimal.size(), fnv1a(decimal));
+        }
+
+        if (!out_path.empty()) {
+            decimal.push_back('\n');
+            const auto write_elapsed = time_ms([&]{ write_file(out_path, decimal.data(), decimal.size()); });
+            spdlog::info("wrote decimal to {} in {}ms", out_path, write_elapsed);
+        }
+        if (!raw_path.empty()) {
+            // Native-endian limbs, least significant first, exactly as GMP stores them
+            const auto write_elapsed = time_ms([&]{
+                write_file(raw_path, reinterpret_cast<char const *>(mpz_limbs_read(f.get_mpz_t())), mpz_size(f.get_mpz_t()) * sizeof(mp_limb_t));
+            });
+            spdlog::info("wrote {} limbs to {} in {}ms", mpz_size(f.get_mpz_t()), raw_path, write_elapsed);
+        }
+    }
+    catch (std::exception const & e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+
     spdlog::info("elapsed: {}ms {} workers", elapsed, n_workers);
     spdlog::info("{} hw cores", std::thread::hardware_concurrency());
 }
@@ -0,0 +1,216 @@
+#include <fibonacci.hpp>
+#include <parallel_mul.hpp>
+#include <parallel_reduce.hpp>
+#include <trace.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <bitset>
+#include <map>
+#include <span>
+#include <string>
+
+namespace {
+
+// Binary digits of n without leading zeros, most significant first
+std::string dec_to_bin(std::size_t n)
+{
+    std::string bin = std::bitset<sizeof(std::size_t) * 8>(n).to_string();
+    auto loc = bin.find('1');
+
+    if (loc != std::string::npos)
+        return bin.substr(loc);
+    return "0";
+}
+
+// A query may be reached by a jump from the previous one if the gap is at most this fraction of it;
+// beyond that F(d) is so large that doubling from a checkpoint is cheaper
+constexpr std::size_t max_jump_divisor = 4;
+
+// Segments per pool thread in a batch
+constexpr std::size_t segments_per_thread = 4;
+
+struct doubled
+{
+    mpz_class f2k_1; // F(2k-1)
+    mpz_class f2k;   // F(2k)
+    mpz_class f2k1;  // F(2k+1)
+};
+
+// Doubling over [F(k - 1), F(k)], which needs only two squarings per bit of N:
+//   F(2k - 1) = F(k)^2 + F(k - 1)^2
+//   F(2k + 1) = 4 F(k)^2 - F(k - 1)^2 + 2 (-1)^k
+//   F(2k)     = F(2k + 1) - F(2k - 1)
+// The squarings of all pairs go to the pool as one batch, so large ones are split across all workers.
+std::vector<doubled> double_pairs(thread_pool & pool, std::span<fib_pair const> pairs)
+{
+    std::vector<mpz_class> squares(2 * pairs.size());
+    std::vector<mul_job> jobs;
+    jobs.reserve(squares.size());
+    for (std::size_t i = 0; i < pairs.size(); ++i) {
+        jobs.push_back({&pairs[i].prev, &pairs[i].prev, &squares[2 * i]});
+        jobs.push_back({&pairs[i].cur, &pairs[i].cur, &squares[2 * i + 1]});
+    }
+    parallel_multiply(pool, jobs);
+
+    std::vector<doubled> res(pairs.size());
+    for (std::size_t i = 0; i < pairs.size(); ++i) {
+        auto const & fk1s = squares[2 * i];    // F(k-1)^2
+        auto const & fks = squares[2 * i + 1]; // F(k)^2
+        auto & d = res[i];
+        d.f2k_1 = fks + fk1s;
+        d.f2k1 = (fks << 2) - fk1s;
+        if (pairs[i].k % 2 != 0) {
+            d.f2k1 -= 2;
+        }
+        else {
+            d.f2k1 += 2;
+        }
+        d.f2k = d.f2k1 - d.f2k_1;
+    }
+    return res;
+}
+
+fib_pair child(fib_pair const & parent, doubled const & d, bool bit)
+{
+    return bit ? fib_pair{2 * parent.k + 1, d.f2k, d.f2k1} : fib_pair{2 * parent.k, d.f2k_1, d.f2k};
+}
+
+// Checkpoints for every k in starts (sorted, nonzero). All starts walk down their binary prefixes
+// together, one bit length per round: a prefix shared by several starts is doubled once, one
+// doubling of k yields both children 2k and 2k + 1, and all doublings of a round share one batch.
+std::map<std::size_t, fib_pair> doubling_trie(thread_pool & pool, std::span<std::size_t const> starts)
+{
+    std::map<std::size_t, fib_pair> checkpoints;
+    std::vector<fib_pair> level(1); // prefixes of the current bit length, ascending
+
+    const auto max_len = static_cast<std::size_t>(std::bit_width(starts.back()));
+    for (std::size_t len = 1;; ++len) {
+        for (auto const & p : level) {
+            if (std::binary_search(starts.begin(), starts.end(), p.k)) {
+                checkpoints.emplace(p.k, p);
+            }
+        }
+        if (len == max_len) {
+            break;
+        }
+        LABS_TRACE_SCOPE_ARG("trie_level", len);
+
+        std::vector<std::size_t> children;
+        for (const auto s : starts) {
+            const auto width = static_cast<std::size_t>(std::bit_width(s));
+            if (width > len) {
+                children.push_back(s >> (width - len - 1));
+            }
+        }
+        std::sort(children.begin(), children.end());
+        children.erase(std::unique(children.begin(), children.end()), children.end());
+
+        std::vector<fib_pair> parents;
+        for (auto & p : level) {
+            if (std::binary_search(children.begin(), children.end(), 2 * p.k) || std::binary_search(children.begin(), children.end(), 2 * p.k + 1)) {
+                parents.push_back(std::move(p));
+            }
+        }
+        const auto ds = double_pairs(pool, parents);
+
+        std::vector<fib_pair> next;
+        next.reserve(children.size());
+        for (const auto c : children) {
+            const auto it = std::lower_bound(parents.begin(), parents.end(), c / 2, [](fib_pair const & p, std::size_t k) { return p.k < k; });
+            next.push_back(child(*it, ds[it - parents.begin()], c % 2 != 0));
+        }
+        level = std::move(next);
+    }
+    return checkpoints;
+}
+
+} // namespace
+
+mpz_class fib(std::size_t N, std::size_t n_workers) {
+    if (N == 0) {
+        return 0;
+    }
+
+    auto & pool = persistent_pool(n_workers);
+
+    auto bin_of_n = dec_to_bin(N);
+
+    fib_pair f; // k=1, the leading bit of N
+
+    for (auto b : bin_of_n.substr(1)) {
+        LABS_TRACE_SCOPE_ARG("doubling", f.k);
+        const auto d = double_pairs(pool, std::span(&f, 1));
+        f = child(f, d[0], b == '1');
+    }
+
+    return f.cur;
+}
+
+std::vector<std::pair<std::size_t, mpz_class>> fib_batch(std::vector<std::size_t> queries, std::size_t n_workers)
+{
+    std::sort(queries.begin(), queries.end());
+    queries.erase(std::unique(queries.begin(), queries.end()), queries.end());
+
+    std::vector<std::pair<std::size_t, mpz_class>> results(queries.size());
+    std::size_t first = 0;
+    if (!queries.empty() && queries[0] == 0) {
+        results[0] = {0, 0};
+        first = 1;
+    }
+    if (first == queries.size()) {
+        return results;
+    }
+
+    auto & pool = persistent_pool(n_workers);
+
+    // Segments [begin, end) of query indices: a new one starts where the gap is too large to jump
+    // or the current one has reached its share of the batch
+    const auto max_segment = std::max<std::size_t>(1, (queries.size() - first) / (segments_per_thread * pool.get_thread_count()));
+    std::vector<std::pair<std::size_t, std::size_t>> segments;
+    for (auto i = first; i < queries.size(); ++i) {
+        const bool split = i == first
+            || i - segments.back().first == max_segment
+            || queries[i] - queries[i - 1] > queries[i - 1] / max_jump_divisor;
+        if (split) {
+            segments.emplace_back(i, i + 1);
+        }
+        else {
+            segments.back().second = i + 1;
+        }
+    }
+
+    std::vector<std::size_t> starts;
+    for (auto const & [begin, end] : segments) {
+        starts.push_back(queries[begin]);
+    }
+    auto checkpoints = doubling_trie(pool, starts);
+
+    std::vector<task_future<void>> futures;
+    for (auto const & [begin, end] : segments) {
+        futures.emplace_back(pool.submit_task([&, begin, end]{
+            LABS_TRACE_SCOPE_ARG("jumps", end - begin);
+            auto f = std::move(checkpoints.at(queries[begin]));
+            results[begin] = {f.k, f.cur};
+
+            // F(d - 1), F(d), F(d + 1) of the last gap, strided batches reuse them for every jump
+            std::size_t gap = 0;
+            mpz_class fd_1, fd, fd1;
+            for (auto i = begin + 1; i < end; ++i) {
+                const auto d = queries[i] - queries[i - 1];
+                if (d != gap) {
+                    mpz_fib2_ui(fd.get_mpz_t(), fd_1.get_mpz_t(), d);
+                    fd1 = fd + fd_1;
+                    gap = d;
+                }
+                mpz_class cur = fd1 * f.cur + fd * f.prev;
+                mpz_class prev = fd * f.cur + fd_1 * f.prev;
+                f = {queries[i], std::move(prev), std::move(cur)};
+                results[i] = {f.k, f.cur};
+            }
+        }));
+    }
+    LABS_TRACE_COUNT(tasks, futures.size());
+    join_all(futures);
+    return results;
+}
@@ -0,0 +1,411 @@
+#include <gemm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GEMM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define GEMM_TARGET(isa)
+#define GEMM_ALWAYS_INLINE __forceinline
+#else
+#define GEMM_TARGET(isa) __attribute__((target(isa)))
+#define GEMM_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace {
+
+// Cache blocking: a KC x NC panel of B stays in L2/L3, an MC x KC panel of A stays in L2,
+// one MR x NR tile of C lives in registers for the whole KC loop.
+constexpr std::size_t KC = 256;
+constexpr std::size_t MC = 96;
+constexpr std::size_t NC = 1024;
+
+template <typename T>
+using kernel_fn = void (*)(std::size_t kc, T const * a, T const * b, T * c, std::size_t ldc);
+
+template <typename T>
+struct micro_kernel
+{
+    std::size_t mr;
+    std::size_t nr;
+    kernel_fn<T> fn;
+};
+
+// c[MR x NR] += a[kc x MR]^T * b[kc x NR], a and b are packed panels
+template <typename T, std::size_t MR, std::size_t NR>
+void kernel_scalar(std::size_t kc, T const * a, T const * b, T * c, std::size_t ldc)
+{
+    T acc[MR][NR] = {};
+    for (std::size_t p = 0; p < kc; ++p) {
+        for (std::size_t i = 0; i < MR; ++i) {
+            const T ai = a[p * MR + i];
+            for (std::size_t j = 0; j < NR; ++j) {
+                acc[i][j] += ai * b[p * NR + j];
+            }
+        }
+    }
+    for (std::size_t i = 0; i < MR; ++i) {
+        for (std::size_t j = 0; j < NR; ++j) {
+            c[i * ldc + j] += acc[i][j];
+        }
+    }
+}
+
+#ifdef GEMM_X86
+
+// Vector traits: one register type per (element type, instruction set) pair.
+// madd(acc, a, b) returns acc + a * b lane-wise.
+
+struct avx2_i32
+{
+    using value_type = int;
+    using reg = __m256i;
+    static constexpr std::size_t lanes = 8;
+    GEMM_TARGET("avx2,fma") static reg zero() { return _mm256_setzero_si256(); }
+    GEMM_TARGET("avx2,fma") static reg load(int const * p) { return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p)); }
+    GEMM_TARGET("avx2,fma") static void store(int * p, reg v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+    GEMM_TARGET("avx2,fma") static reg set1(int x) { return _mm256_set1_epi32(x); }
+    GEMM_TARGET("avx2,fma") static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+    GEMM_TARGET("avx2,fma") static reg madd(reg acc, reg a, reg b) { return _mm256_add_epi32(acc, _mm256_mullo_epi32(a, b)); }
+};
+
+struct avx2_f32
+{
+    using value_type = float;
+    using reg = __m256;
+    static constexpr std::size_t lanes = 8;
+    GEMM_TARGET("avx2,fma") static reg zero() { return _mm256_setzero_ps(); }
+    GEMM_TARGET("avx2,fma") static reg load(float const * p) { return _mm256_loadu_ps(p); }
+    GEMM_TARGET("avx2,fma") static void store(float * p, reg v) { _mm256_storeu_ps(p, v); }
+    GEMM_TARGET("avx2,fma") static reg set1(float x) { return _mm256_set1_ps(x); }
+    GEMM_TARGET("avx2,fma") static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    GEMM_TARGET("avx2,fma") static reg madd(reg acc, reg a, reg b) { return _mm256_fmadd_ps(a, b, acc); }
+};
+
+struct avx2_f64
+{
+    using value_type = double;
+    using reg = __m256d;
+    static constexpr std::size_t lanes = 4;
+    GEMM_TARGET("avx2,fma") static reg zero() { return _mm256_setzero_pd(); }
+    GEMM_TARGET("avx2,fma") static reg load(double const * p) { return _mm256_loadu_pd(p); }
+    GEMM_TARGET("avx2,fma") static void store(double * p, reg v) { _mm256_storeu_pd(p, v); }
+    GEMM_TARGET("avx2,fma") static reg set1(double x) { return _mm256_set1_pd(x); }
+    GEMM_TARGET("avx2,fma") static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    GEMM_TARGET("avx2,fma") static reg madd(reg acc, reg a, reg b) { return _mm256_fmadd_pd(a, b, acc); }
+};
+
+struct avx512_i32
+{
+    using value_type = int;
+    using reg = __m512i;
+    static constexpr std::size_t lanes = 16;
+    GEMM_TARGET("avx512f") static reg zero() { return _mm512_setzero_si512(); }
+    GEMM_TARGET("avx512f") static reg load(int const * p) { return _mm512_loadu_si512(p); }
+    GEMM_TARGET("avx512f") static void store(int * p, reg v) { _mm512_storeu_si512(p, v); }
+    GEMM_TARGET("avx512f") static reg set1(int x) { return _mm512_set1_epi32(x); }
+    GEMM_TARGET("avx512f") static reg add(reg a, reg b) { return _mm512_add_epi32(a, b); }
+    GEMM_TARGET("avx512f") static reg madd(reg acc, reg a, reg b) { return _mm512_add_epi32(acc, _mm512_mullo_epi32(a, b)); }
+};
+
+// AVX-512F has no native 64-bit multiply; mullox expands to three 32x32 products
+struct avx512_i64
+{
+    using value_type = std::int64_t;
+    using reg = __m512i;
+    static constexpr std::size_t lanes = 8;
+    GEMM_TARGET("avx512f") static reg zero() { return _mm512_setzero_si512(); }
+    GEMM_TARGET("avx512f") static reg load(std::int64_t const * p) { return _mm512_loadu_si512(p); }
+    GEMM_TARGET("avx512f") static void store(std::int64_t * p, reg v) { _mm512_storeu_si512(p, v); }
+    GEMM_TARGET("avx512f") static reg set1(std::int64_t x) { return _mm512_set1_epi64(x); }
+    GEMM_TARGET("avx512f") static reg add(reg a, reg b) { return _mm512_add_epi64(a, b); }
+    GEMM_TARGET("avx512f") static reg madd(reg acc, reg a, reg b) { return _mm512_add_epi64(acc, _mm512_mullox_epi64(a, b)); }
+};
+
+struct avx512_f32
+{
+    using value_type = float;
+    using reg = __m512;
+    static constexpr std::size_t lanes = 16;
+    GEMM_TARGET("avx512f") static reg zero() { return _mm512_setzero_ps(); }
+    GEMM_TARGET("avx512f") static reg load(float const * p) { return _mm512_loadu_ps(p); }
+    GEMM_TARGET("avx512f") static void store(float * p, reg v) { _mm512_storeu_ps(p, v); }
+    GEMM_TARGET("avx512f") static reg set1(float x) { return _mm512_set1_ps(x); }
+    GEMM_TARGET("avx512f") static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    GEMM_TARGET("avx512f") static reg madd(reg acc, reg a, reg b) { return _mm512_fmadd_ps(a, b, acc); }
+};
+
+struct avx512_f64
+{
+    using value_type = double;
+    using reg = __m512d;
+    static constexpr std::size_t lanes = 8;
+    GEMM_TARGET("avx512f") static reg zero() { return _mm512_setzero_pd(); }
+    GEMM_TARGET("avx512f") static reg load(double const * p) { return _mm512_loadu_pd(p); }
+    GEMM_TARGET("avx512f") static void store(double * p, reg v) { _mm512_storeu_pd(p, v); }
+    GEMM_TARGET("avx512f") static reg set1(double x) { return _mm512_set1_pd(x); }
+    GEMM_TARGET("avx512f") static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    GEMM_TARGET("avx512f") static reg madd(reg acc, reg a, reg b) { return _mm512_fmadd_pd(a, b, acc); }
+};
+
+// MR x (2 * lanes) tile: 2 * MR vector accumulators + 2 B vectors + 1 broadcast, the same body for
+// every vector type V. It only ever runs inlined into a kernel compiled for V's target, so GCC's note
+// about passing vectors under the default-target ABI doesn't apply.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+template <typename V, std::size_t MR>
+GEMM_ALWAYS_INLINE void kernel_vec(std::size_t kc, typename V::value_type const * a, typename V::value_type const * b, typename V::value_type * c, std::size_t ldc)
+{
+    constexpr std::size_t NR = 2 * V::lanes;
+
+    typename V::reg acc[MR][2];
+    for (std::size_t i = 0; i < MR; ++i) {
+        acc[i][0] = V::zero();
+        acc[i][1] = V::zero();
+    }
+
+    for (std::size_t p = 0; p < kc; ++p) {
+        const auto b0 = V::load(b + p * NR);
+        const auto b1 = V::load(b + p * NR + V::lanes);
+        for (std::size_t i = 0; i < MR; ++i) {
+            const auto ai = V::set1(a[p * MR + i]);
+            acc[i][0] = V::madd(acc[i][0], ai, b0);
+            acc[i][1] = V::madd(acc[i][1], ai, b1);
+        }
+    }
+
+    for (std::size_t i = 0; i < MR; ++i) {
+        auto row = c + i * ldc;
+        V::store(row, V::add(V::load(row), acc[i][0]));
+        V::store(row + V::lanes, V::add(V::load(row + V::lanes), acc[i][1]));
+    }
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Entry points per instruction set: the target attribute can't be a template argument, so kernel_vec
+// is forced inline into a function compiled for V's target (also without optimization, where a call
+// from the default target would pass the vectors under a different ABI)
+template <typename V, std::size_t MR>
+GEMM_TARGET("avx2,fma")
+void kernel_avx2(std::size_t kc, typename V::value_type const * a, typename V::value_type const * b, typename V::value_type * c, std::size_t ldc)
+{
+    kernel_vec<V, MR>(kc, a, b, c, ldc);
+}
+
+template <typename V, std::size_t MR>
+GEMM_TARGET("avx512f")
+void kernel_avx512(std::size_t kc, typename V::value_type const * a, typename V::value_type const * b, typename V::value_type * c, std::size_t ldc)
+{
+    kernel_vec<V, MR>(kc, a, b, c, ldc);
+}
+
+template <typename V, std::size_t MR>
+constexpr auto avx2_kernel = micro_kernel<typename V::value_type>{MR, 2 * V::lanes, kernel_avx2<V, MR>};
+
+template <typename V, std::size_t MR>
+constexpr auto avx512_kernel = micro_kernel<typename V::value_type>{MR, 2 * V::lanes, kernel_avx512<V, MR>};
+
+#endif
+
+template <typename T>
+micro_kernel<T> select_kernel(gemm_isa isa);
+
+template <>
+micro_kernel<int> select_kernel<int>(gemm_isa isa)
+{
+    switch (isa) {
+#ifdef GEMM_X86
+    case gemm_isa::avx512: return avx512_kernel<avx512_i32, 8>;
+    case gemm_isa::avx2:   return avx2_kernel<avx2_i32, 6>;
+#endif
+    default:               return {4, 8, kernel_scalar<int, 4, 8>};
+    }
+}
+
+// AVX2 has no 64-bit multiply at all, so int64 stays on the scalar tile below AVX-512
+template <>
+micro_kernel<std::int64_t> select_kernel<std::int64_t>(gemm_isa isa)
+{
+    switch (isa) {
+#ifdef GEMM_X86
+    case gemm_isa::avx512: return avx512_kernel<avx512_i64, 8>;
+#endif
+    default:               return {4, 4, kernel_scalar<std::int64_t, 4, 4>};
+    }
+}
+
+template <>
+micro_kernel<float> select_kernel<float>(gemm_isa isa)
+{
+    switch (isa) {
+#ifdef GEMM_X86
+    case gemm_isa::avx512: return avx512_kernel<avx512_f32, 8>;
+    case gemm_isa::avx2:   return avx2_kernel<avx2_f32, 6>;
+#endif
+    default:               return {4, 8, kernel_scalar<float, 4, 8>};
+    }
+}
+
+template <>
+micro_kernel<double> select_kernel<double>(gemm_isa isa)
+{
+    switch (isa) {
+#ifdef GEMM_X86
+    case gemm_isa::avx512: return avx512_kernel<avx512_f64, 8>;
+    case gemm_isa::avx2:   return avx2_kernel<avx2_f64, 6>;
+#endif
+    default:               return {4, 4, kernel_scalar<double, 4, 4>};
+    }
+}
+
+// Copy rows [0, mc) x cols [0, kc) of A into MR-row panels, zero-padding the last one
+template <typename T>
+void pack_a(T const * A, std::size_t lda, std::size_t mc, std::size_t kc, std::size_t mr, T * out)
+{
+    for (std::size_t ir = 0; ir < mc; ir += mr) {
+        const auto rows = std::min(mr, mc - ir);
+        for (std::size_t p = 0; p < kc; ++p) {
+            for (std::size_t i = 0; i < rows; ++i) {
+                out[p * mr + i] = A[(ir + i) * lda + p];
+            }
+            for (std::size_t i = rows; i < mr; ++i) {
+                out[p * mr + i] = T{};
+            }
+        }
+        out += mr * kc;
+    }
+}
+
+// Copy rows [0, kc) x cols [0, nc) of B into NR-column panels, zero-padding the last one
+template <typename T>
+void pack_b(T const * B, std::size_t ldb, std::size_t kc, std::size_t nc, std::size_t nr, T * out)
+{
+    for (std::size_t jr = 0; jr < nc; jr += nr) {
+        const auto cols = std::min(nr, nc - jr);
+        for (std::size_t p = 0; p < kc; ++p) {
+            T const * src = B + p * ldb + jr;
+            std::copy(src, src + cols, out + p * nr);
+            std::fill(out + p * nr + cols, out + (p + 1) * nr, T{});
+        }
+        out += nr * kc;
+    }
+}
+
+std::size_t round_up(std::size_t x, std::size_t m)
+{
+    return (x + m - 1) / m * m;
+}
+
+} // namespace
+
+gemm_isa detect_gemm_isa()
+{
+    static const gemm_isa isa = []{
+#if defined(GEMM_X86) && !defined(_MSC_VER)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return gemm_isa::avx512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return gemm_isa::avx2;
+#elif defined(GEMM_X86)
+        int regs[4];
+        __cpuid(regs, 0);
+        if (regs[0] < 7) return gemm_isa::scalar;
+
+        __cpuid(regs, 1);
+        const bool osxsave = (regs[2] & (1 << 27)) != 0;
+        const bool avx = (regs[2] & (1 << 28)) != 0;
+        const bool fma = (regs[2] & (1 << 12)) != 0;
+        if (!osxsave || !avx) return gemm_isa::scalar;
+
+        // The OS has to save ymm (and zmm/opmask) state on context switch
+        const auto xcr0 = _xgetbv(0);
+        __cpuidex(regs, 7, 0);
+        if ((regs[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6) return gemm_isa::avx512;
+        if ((regs[1] & (1 << 5)) && fma && (xcr0 & 0x6) == 0x6) return gemm_isa::avx2;
+#endif
+        return gemm_isa::scalar;
+    }();
+    return isa;
+}
+
+std::string_view gemm_isa_name(gemm_isa isa)
+{
+    switch (isa) {
+    case gemm_isa::avx512: return "avx512";
+    case gemm_isa::avx2:   return "avx2";
+    default:               return "scalar";
+    }
+}
+
+template <typename T>
+void block_gemm(
+    T const * A, std::size_t lda,
+    T const * B, std::size_t ldb,
+    T * C, std::size_t ldc,
+    std::size_t m, std::size_t n, std::size_t k
+)
+{
+    static const auto kernel = select_kernel<T>(detect_gemm_isa());
+    const auto mr = kernel.mr;
+    const auto nr = kernel.nr;
+
+    // Per-thread packing buffers, reused across calls
+    thread_local std::vector<T> a_pack;
+    thread_local std::vector<T> b_pack;
+    thread_local std::vector<T> c_edge;
+    a_pack.resize(round_up(MC, mr) * KC);
+    b_pack.resize(round_up(NC, nr) * KC);
+    c_edge.resize(mr * nr);
+
+    for (std::size_t jc = 0; jc < n; jc += NC) {
+        const auto nc = std::min(NC, n - jc);
+        for (std::size_t pc = 0; pc < k; pc += KC) {
+            const auto kc = std::min(KC, k - pc);
+            pack_b(B + pc * ldb + jc, ldb, kc, nc, nr, b_pack.data());
+
+            for (std::size_t ic = 0; ic < m; ic += MC) {
+                const auto mc = std::min(MC, m - ic);
+                pack_a(A + ic * lda + pc, lda, mc, kc, mr, a_pack.data());
+
+                for (std::size_t jr = 0; jr < nc; jr += nr) {
+                    const auto cols = std::min(nr, nc - jr);
+                    T const * bp = b_pack.data() + jr * kc;
+                    for (std::size_t ir = 0; ir < mc; ir += mr) {
+                        const auto rows = std::min(mr, mc - ir);
+                        T const * ap = a_pack.data() + ir * kc;
+                        T * c = C + (ic + ir) * ldc + jc + jr;
+
+                        if (rows == mr && cols == nr) {
+                            kernel.fn(kc, ap, bp, c, ldc);
+                            continue;
+                        }
+
+                        // Edge tile: compute the full padded tile aside, add back the valid part
+                        std::fill(c_edge.begin(), c_edge.end(), T{});
+                        kernel.fn(kc, ap, bp, c_edge.data(), nr);
+                        for (std::size_t i = 0; i < rows; ++i) {
+                            for (std::size_t j = 0; j < cols; ++j) {
+                                c[i * ldc + j] += c_edge[i * nr + j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+template void block_gemm<int>(int const *, std::size_t, int const *, std::size_t, int *, std::size_t, std::size_t, std::size_t, std::size_t);
+template void block_gemm<std::int64_t>(std::int64_t const *, std::size_t, std::int64_t const *, std::size_t, std::int64_t *, std::size_t, std::size_t, std::size_t, std::size_t);
+template void block_gemm<float>(float const *, std::size_t, float const *, std::size_t, float *, std::size_t, std::size_t, std::size_t, std::size_t);
+template void block_gemm<double>(double const *, std::size_t, double const *, std::size_t, double *, std::size_t, std::size_t, std::size_t, std::size_t);
@@ -0,0 +1,98 @@
+#include <int_parser.hpp>
+#include <mapped_file.hpp>
+#include <thread_pool.hpp>
+#include <trace.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+} // namespace
+
+std::vector<std::string_view> split_at_commas(std::string_view text, std::size_t n_parts)
+{
+    if (n_parts == 0) {
+        throw std::invalid_argument("split_at_commas: n_parts must be positive");
+    }
+    std::vector<std::string_view> parts;
+    std::size_t begin = 0;
+    for (std::size_t i = 1; i <= n_parts && begin < text.size(); ++i) {
+        auto end = i == n_parts ? text.size() : std::max(begin, text.size() * i / n_parts);
+        if (end < text.size()) {
+            const auto comma = text.find(',', end);
+            end = comma == std::string_view::npos ? text.size() : comma + 1;
+        }
+        parts.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+    return parts;
+}
+
+std::size_t parse_ints(std::string_view text, std::vector<int> & out, std::size_t max_count, std::size_t offset)
+{
+    const char * p = text.data();
+    const char * end = text.data() + text.size();
+
+    for (std::size_t count = 0; count < max_count; ++count) {
+        while (p != end && is_space(*p)) ++p;
+        if (p == end) break;
+
+        int value;
+        const auto [next, ec] = std::from_chars(p, end, value);
+        if (ec != std::errc{}) {
+            throw std::runtime_error("malformed number at byte " + std::to_string(offset + static_cast<std::size_t>(p - text.data())));
+        }
+        out.push_back(value);
+
+        p = next;
+        while (p != end && is_space(*p)) ++p;
+        if (p != end) {
+            if (*p != ',') {
+                throw std::runtime_error("expected ',' at byte " + std::to_string(offset + static_cast<std::size_t>(p - text.data())));
+            }
+            ++p;
+        }
+    }
+    return static_cast<std::size_t>(p - text.data());
+}
+
+std::vector<int> parse_int_file(std::filesystem::path const & path, std::size_t n_workers)
+{
+    const mapped_file file{path};
+    file.advise_sequential();
+
+    const auto parts = split_at_commas(file.text(), n_workers);
+    std::vector<std::vector<int>> parsed(parts.size());
+
+    auto & pool = persistent_pool(n_workers);
+
+    // Pass 1: every worker parses its piece into a private vector
+    run_tasks(pool, parts.size(), [&](std::size_t i) {
+        LABS_TRACE_SCOPE("parse");
+        LABS_TRACE_COUNT(bytes, parts[i].size());
+        parsed[i].reserve(std::count(parts[i].begin(), parts[i].end(), ',') + 1);
+        parse_ints(parts[i], parsed[i], static_cast<std::size_t>(-1), static_cast<std::size_t>(parts[i].data() - file.text().data()));
+    });
+
+    // Pass 2: pieces are copied side by side into the result
+    std::vector<std::size_t> offsets(parts.size() + 1, 0);
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+        offsets[i + 1] = offsets[i] + parsed[i].size();
+    }
+    std::vector<int> numbers(offsets.back());
+    run_tasks(pool, parts.size(), [&](std::size_t i) {
+        LABS_TRACE_SCOPE("concat");
+        std::copy(parsed[i].begin(), parsed[i].end(), numbers.begin() + offsets[i]);
+    });
+
+    return numbers;
+}
@@ -0,0 +1,163 @@
+#include <mapped_file.hpp>
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+int last_error()
+{
+#ifdef _WIN32
+    return static_cast<int>(GetLastError());
+#else
+    return errno;
+#endif
+}
+
+[[noreturn]] void throw_error(int code, std::string const & what)
+{
+#ifdef _WIN32
+    throw std::system_error(code, std::system_category(), what);
+#else
+    throw std::system_error(code, std::generic_category(), what);
+#endif
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(std::filesystem::path const & path)
+{
+    file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        throw_error(last_error(), "open " + path.string());
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+        const auto err = last_error();
+        unmap();
+        throw_error(err, "stat " + path.string());
+    }
+    size_ = static_cast<std::size_t>(size.QuadPart);
+    if (size_ == 0) {
+        return;
+    }
+
+    mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ == nullptr) {
+        const auto err = last_error();
+        unmap();
+        throw_error(err, "map " + path.string());
+    }
+    data_ = static_cast<std::byte const *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+        const auto err = last_error();
+        unmap();
+        throw_error(err, "map " + path.string());
+    }
+}
+
+void mapped_file::unmap() noexcept
+{
+    if (data_ != nullptr) UnmapViewOfFile(data_);
+    if (mapping_ != nullptr) CloseHandle(mapping_);
+    if (file_ != nullptr) CloseHandle(file_);
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = nullptr;
+    size_ = 0;
+}
+
+void mapped_file::advise_sequential() const
+{
+}
+
+#else
+
+mapped_file::mapped_file(std::filesystem::path const & path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw_error(last_error(), "open " + path.string());
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        const auto err = last_error();
+        ::close(fd);
+        throw_error(err, "stat " + path.string());
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+
+    if (size_ != 0) {
+        void * p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            const auto err = last_error();
+            ::close(fd);
+            size_ = 0;
+            throw_error(err, "mmap " + path.string());
+        }
+        data_ = static_cast<std::byte const *>(p);
+    }
+
+    // The mapping keeps the file alive on its own
+    ::close(fd);
+}
+
+void mapped_file::unmap() noexcept
+{
+    if (data_ != nullptr) {
+        ::munmap(const_cast<std::byte *>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+void mapped_file::advise_sequential() const
+{
+    if (data_ != nullptr) {
+        ::madvise(const_cast<std::byte *>(data_), size_, MADV_SEQUENTIAL);
+    }
+}
+
+#endif
+
+mapped_file::~mapped_file()
+{
+    unmap();
+}
+
+mapped_file::mapped_file(mapped_file && other) noexcept
+{
+    *this = std::move(other);
+}
+
+mapped_file & mapped_file::operator=(mapped_file && other) noexcept
+{
+    if (this != &other) {
+        unmap();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+        file_ = std::exchange(other.file_, nullptr);
+        mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
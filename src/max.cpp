@@ -4,61 +4,83 @@
 #include <fstream>
 #include <span>
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string_view>
 
 #include <spdlog/spdlog.h>
 
-int max_of(std::span<int> data)
-{
-    return *std::max_element(data.begin(), data.end());
-}
+#include <int_parser.hpp>
+#include <mapped_file.hpp>
+#include <max.hpp>
+#include <parallel_reduce.hpp>
+#include <trace.hpp>
 
 int maximum(std::vector<int> & numbers, std::size_t n_workers)
 {
-    const std::size_t chunk_size = numbers.size() / n_workers;
-    const std::size_t chunk_remainder = chunk_size + numbers.size() % n_workers;
-    std::vector<std::thread> workers;
-
-    std::vector<int> max_values(n_workers, 0);
+    auto & pool = persistent_pool(n_workers);
+    return parallel_reduce(pool, std::span<int const>(numbers), std::numeric_limits<int>::min(),
+        [](int a, int b) { return std::max(a, b); }, 1 << 16);
+}
 
-    for (std::size_t i = 0; i < n_workers - 1; ++i) {
-        workers.emplace_back(std::thread([&, i]{
-            std::span<int> chunk(numbers.begin() + chunk_size * i, chunk_size);
-            max_values[i] = max_of(chunk);
-        }));
+// Fold one parsed batch in: the min/max/sum loops are branch-free and vectorize, the argmax
+// position is only searched for when the batch actually raises the maximum
+void accumulate(int_stats & s, std::span<int const> batch)
+{
+    int lo = s.min;
+    int hi = std::numeric_limits<int>::min();
+    std::int64_t sum = 0;
+    for (const int x : batch) {
+        lo = std::min(lo, x);
+        hi = std::max(hi, x);
+        sum += x;
     }
 
-    std::span<int> chunk(numbers.begin() + chunk_size * (n_workers - 1), numbers.end());
-    max_values[n_workers - 1] = max_of(chunk);
-
-    for (auto & w : workers) {
-        w.join();
+    if (s.count == 0 || hi > s.max) {
+        s.max = hi;
+        s.argmax = s.count + (std::find(batch.begin(), batch.end(), hi) - batch.begin());
     }
-
-    return max_of(max_values);
+    s.min = lo;
+    s.sum += sum;
+    s.count += batch.size();
 }
 
-int main(int argc, char** argv)
+void combine(int_stats & left, int_stats const & right)
 {
-    const std::string path = argv[1];
-    const std::size_t n_workers = std::stoull(argv[2]);
-
-    spdlog::info("Find max from {} and sort with {} workers", path, n_workers);
-
-    std::ifstream file{path};
-    std::string line;
-    std::vector<int> numbers;
-    while (std::getline(file, line, ',')) {
-        numbers.emplace_back(std::stoi(line));
+    if (right.count == 0) {
+        return;
+    }
+    if (left.count == 0 || right.max > left.max) {
+        left.max = right.max;
+        left.argmax = left.count + right.argmax;
     }
+    left.min = std::min(left.min, right.min);
+    left.sum += right.sum;
+    left.count += right.count;
+}
 
-    const auto start = std::chrono::high_resolution_clock::now();
+// Single pass over the mapped file: every worker parses its comma-aligned byte range batch by batch
+// and folds it into running stats, the numbers themselves are never stored
+int_stats stream_stats(std::string const & path, std::size_t n_workers)
+{
+    const mapped_file file{path};
+    file.advise_sequential();
 
-    auto max = maximum(numbers, n_workers);
+    const auto parts = split_at_commas(file.text(), n_workers);
+    std::vector<int_stats> stats(parts.size());
 
-    const auto finish = std::chrono::high_resolution_clock::now();
-    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+    run_tasks(persistent_pool(n_workers), parts.size(), [&](std::size_t i) {
+        LABS_TRACE_SCOPE("stream_stats");
+        LABS_TRACE_COUNT(bytes, parts[i].size());
+        int_stats local;
+        const auto offset = static_cast<std::size_t>(parts[i].data() - file.text().data());
+        for_each_int_batch(parts[i], offset, [&](std::span<int const> batch) { accumulate(local, batch); });
+        stats[i] = local;
+    });
 
-    spdlog::info("max value is {}", max);
-    spdlog::info("elapsed: {}mcs {} workers", elapsed, n_workers);
-    spdlog::info("{} hw cores", std::thread::hardware_concurrency());
+    int_stats total;
+    for (auto const & s : stats) {
+        combine(total, s);
+    }
+    return total;
 }
@@ -0,0 +1,71 @@
+#include <chrono>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include <int_parser.hpp>
+#include <max.hpp>
+#include <trace.hpp>
+
+int main(int argc, char** argv)
+{
+    LABS_TRACE_SESSION("max");
+    const std::string path = argv[1];
+    const std::size_t n_workers = std::stoull(argv[2]);
+
+    if (argc > 3 && std::string_view{argv[3]} == "--stream") {
+        spdlog::info("Stream max from {} with {} workers", path, n_workers);
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        int_stats stats;
+        try {
+            stats = stream_stats(path, n_workers);
+        }
+        catch (std::exception const & e) {
+            spdlog::error("{}", e.what());
+            return 1;
+        }
+        const auto finish = std::chrono::high_resolution_clock::now();
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+
+        if (stats.count == 0) {
+            spdlog::error("no numbers in {}", path);
+            return 1;
+        }
+        spdlog::info("max value is {} (first at index {})", stats.max, stats.argmax);
+        spdlog::info("min={} sum={} count={}", stats.min, stats.sum, stats.count);
+        spdlog::info("elapsed: {}mcs {} workers (parse and reduce)", elapsed, n_workers);
+        spdlog::info("{} hw cores", std::thread::hardware_concurrency());
+        return 0;
+    }
+
+    spdlog::info("Find max from {} and sort with {} workers", path, n_workers);
+
+    const auto parse_start = std::chrono::high_resolution_clock::now();
+    std::vector<int> numbers;
+    try {
+        numbers = parse_int_file(path, n_workers);
+    }
+    catch (std::exception const & e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+    const auto parse_finish = std::chrono::high_resolution_clock::now();
+    const auto parse_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(parse_finish - parse_start).count();
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    auto max = maximum(numbers, n_workers);
+
+    const auto finish = std::chrono::high_resolution_clock::now();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+
+    spdlog::info("max value is {}", max);
+    spdlog::info("parsed {} numbers in {}mcs", numbers.size(), parse_elapsed);
+    spdlog::info("elapsed: {}mcs {} workers", elapsed, n_workers);
+    spdlog::info("{} hw cores", std::thread::hardware_concurrency());
+}
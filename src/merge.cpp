@@ -4,64 +4,333 @@
 #include <fstream>
 #include <span>
 #include <algorithm>
+#include <limits>
+#include <vector>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
 
 #include <spdlog/spdlog.h>
+#include <spdlog/fmt/std.h>
+
+#include <int_parser.hpp>
+#include <mapped_file.hpp>
+#include <merge.hpp>
+#include <thread_pool.hpp>
+#include <trace.hpp>
+
+namespace fs = std::filesystem;
 
 void sort_chunk(std::span<int> data)
 {
+    LABS_TRACE_SCOPE("sort");
+    LABS_TRACE_COUNT(elements, data.size());
     std::sort(data.begin(), data.end());
 }
 
+// Merge sorted runs into dst, using tmp (same size as dst) as scratch: each half of the runs is merged
+// into the matching half of tmp (with dst as its scratch), then the two halves are merged into dst
+void merge_runs(std::span<std::span<int const> const> runs, std::span<int> dst, std::span<int> tmp)
+{
+    if (runs.size() == 1) {
+        std::copy(runs[0].begin(), runs[0].end(), dst.begin());
+        return;
+    }
+    if (runs.size() == 2) {
+        std::merge(runs[0].begin(), runs[0].end(), runs[1].begin(), runs[1].end(), dst.begin());
+        return;
+    }
+
+    const auto mid = runs.size() / 2;
+    std::size_t left_size = 0;
+    for (auto const & r : runs.first(mid)) {
+        left_size += r.size();
+    }
+
+    merge_runs(runs.first(mid), tmp.first(left_size), dst.first(left_size));
+    merge_runs(runs.subspan(mid), tmp.subspan(left_size), dst.subspan(left_size));
+    std::merge(tmp.begin(), tmp.begin() + left_size, tmp.begin() + left_size, tmp.end(), dst.begin());
+}
+
+// Split positions in every sorted chunk such that the first `rank` elements of the merged output
+// are exactly the chunk prefixes [0, split[i]). Finds the rank-th smallest value by bisection over
+// the value range, then hands out its duplicates in chunk order, so splits are monotone in rank.
+std::vector<std::size_t> co_rank(std::span<std::span<int const> const> chunks, std::size_t rank)
+{
+    std::vector<std::size_t> split(chunks.size(), 0);
+    if (rank == 0) {
+        return split;
+    }
+
+    auto count_le = [&](std::int64_t v) {
+        std::size_t count = 0;
+        for (auto const & c : chunks) {
+            count += std::upper_bound(c.begin(), c.end(), v) - c.begin();
+        }
+        return count;
+    };
+
+    std::int64_t lo = std::numeric_limits<int>::min();
+    std::int64_t hi = std::numeric_limits<int>::max();
+    while (lo < hi) {
+        const auto mid = lo + (hi - lo) / 2;
+        if (count_le(mid) >= rank) {
+            hi = mid;
+        }
+        else {
+            lo = mid + 1;
+        }
+    }
+
+    std::size_t taken = 0;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        split[i] = std::lower_bound(chunks[i].begin(), chunks[i].end(), lo) - chunks[i].begin();
+        taken += split[i];
+    }
+    for (std::size_t i = 0; i < chunks.size() && taken < rank; ++i) {
+        const std::size_t equal = std::upper_bound(chunks[i].begin(), chunks[i].end(), lo) - chunks[i].begin() - split[i];
+        const auto take = std::min(equal, rank - taken);
+        split[i] += take;
+        taken += take;
+    }
+    return split;
+}
+
+// Worker w produces output range [w * n / p, (w + 1) * n / p): it locates that range in every chunk
+// with co_rank and merges its pieces on its own, so all workers write disjoint parts of out
+void parallel_merge(thread_pool & pool, std::span<std::span<int const> const> chunks, std::span<int> out, std::size_t n_workers)
+{
+    const auto n = out.size();
+    auto part = [&](std::size_t w) {
+        const auto begin = n * w / n_workers;
+        const auto end = n * (w + 1) / n_workers;
+        LABS_TRACE_SCOPE("merge");
+        const auto from = co_rank(chunks, begin);
+        const auto to = co_rank(chunks, end);
+
+        std::vector<std::span<int const>> runs;
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            if (from[i] != to[i]) {
+                runs.push_back(chunks[i].subspan(from[i], to[i] - from[i]));
+            }
+        }
+        if (runs.empty()) {
+            return;
+        }
+
+        std::vector<int> tmp(end - begin);
+        merge_runs(runs, out.subspan(begin, end - begin), tmp);
+        LABS_TRACE_COUNT(elements, end - begin);
+    };
+
+    run_tasks(pool, n_workers, part);
+}
+
 void merge_sort(std::vector<int> & numbers, std::size_t n_workers)
 {
+    if (n_workers == 0) {
+        throw std::invalid_argument("merge_sort: n_workers must be positive");
+    }
+    auto & pool = persistent_pool(n_workers);
+
     const std::size_t chunk_size = numbers.size() / n_workers;
-    const std::size_t chunk_remainder = chunk_size + numbers.size() % n_workers;
-    std::vector<std::thread> workers;
-    for (std::size_t i = 0; i < n_workers - 1; ++i) {
-        workers.emplace_back(std::thread([&, i]{
-            std::span<int> chunk(numbers.begin() + chunk_size * i, chunk_size);
-            sort_chunk(chunk);
-        }));
+    run_tasks(pool, n_workers, [&](std::size_t i) {
+        const auto end = i == n_workers - 1 ? numbers.end() : numbers.begin() + chunk_size * (i + 1);
+        sort_chunk(std::span<int>(numbers.begin() + chunk_size * i, end));
+    });
+
+    if (n_workers == 1) {
+        return;
     }
 
-    std::span<int> chunk(numbers.begin() + chunk_size * (n_workers - 1), numbers.end());
-    sort_chunk(chunk);
+    std::vector<std::span<int const>> chunks;
+    for (std::size_t i = 0; i < n_workers; ++i) {
+        const auto begin = chunk_size * i;
+        const auto end = i == n_workers - 1 ? numbers.size() : begin + chunk_size;
+        chunks.emplace_back(numbers.data() + begin, end - begin);
+    }
+
+    std::vector<int> sorted(numbers.size());
+    parallel_merge(pool, chunks, sorted, n_workers);
+    numbers.swap(sorted);
+}
+
+// Sequential reader over one spilled run (raw native-endian ints), refilled in large blocks.
+// A short read that isn't at end of file throws, so an I/O error can't look like a finished run.
+class run_reader
+{
+public:
+    run_reader(fs::path const & path, std::size_t buffer_elems)
+        : path_{path}
+        , file_{path, std::ios::binary}
+        , buf_(buffer_elems)
+    {
+        if (!file_) {
+            throw std::runtime_error(fmt::format("failed to open {}", path_));
+        }
+    }
+
+    bool next(int & value)
+    {
+        if (pos_ == len_) {
+            file_.read(reinterpret_cast<char *>(buf_.data()), static_cast<std::streamsize>(buf_.size() * sizeof(int)));
+            if (file_.bad() || (file_.fail() && !file_.eof())) {
+                throw std::runtime_error(fmt::format("failed to read {}", path_));
+            }
+            len_ = static_cast<std::size_t>(file_.gcount()) / sizeof(int);
+            pos_ = 0;
+            if (len_ == 0) {
+                return false;
+            }
+        }
+        value = buf_[pos_++];
+        return true;
+    }
+
+private:
+    fs::path path_;
+    std::ifstream file_;
+    std::vector<int> buf_;
+    std::size_t pos_ = 0;
+    std::size_t len_ = 0;
+};
+
+// Removes the spill directory however external_sort exits
+class runs_dir_guard
+{
+public:
+    explicit runs_dir_guard(fs::path dir)
+        : dir_{std::move(dir)}
+    {
+        fs::create_directories(dir_);
+    }
 
-    for (auto & w : workers) {
-        w.join();
+    ~runs_dir_guard()
+    {
+        std::error_code ec;
+        fs::remove_all(dir_, ec);
     }
 
-    auto mid = numbers.begin() + chunk_size;
-    for (std::size_t i = 0; i < n_workers - 1; ++i) {
-        std::inplace_merge(numbers.begin(), mid, mid + (i == n_workers - 2 ? chunk_remainder : chunk_size));
-        mid += chunk_size;
+    runs_dir_guard(runs_dir_guard const &) = delete;
+    runs_dir_guard & operator=(runs_dir_guard const &) = delete;
+
+    fs::path const & path() const { return dir_; }
+
+private:
+    fs::path dir_;
+};
+
+void write_checked(std::ofstream & out, char const * data, std::size_t size, fs::path const & path)
+{
+    out.write(data, static_cast<std::streamsize>(size));
+    if (!out) {
+        throw std::runtime_error(fmt::format("failed to write {}", path));
     }
 }
 
-int main(int argc, char** argv)
+// Out-of-core sort: read at most memory_budget / 3 bytes of numbers at a time (merge_sort needs the same
+// again for its output buffer and once more for the scratch of parallel_merge), sort them in parallel and
+// spill each run as raw ints, then k-way merge the runs through a heap. In the merge phase three quarters
+// of the budget go to the per-run read buffers and the rest to the output buffer.
+// The output format is the same as the in-memory path: numbers joined by "," with no trailing newline.
+// Any read or write error throws; the spilled runs are removed either way.
+void external_sort(fs::path const & path, fs::path const & out_path, std::size_t n_workers, std::size_t memory_budget)
 {
-    const std::string path = argv[1];
-    const std::size_t n_workers = std::stoull(argv[2]);
+    if (n_workers == 0) {
+        throw std::invalid_argument("external_sort: n_workers must be positive");
+    }
+    const auto run_capacity = std::max<std::size_t>(memory_budget / (3 * sizeof(int)), 1);
+    const runs_dir_guard runs_dir{fs::path(out_path).concat(".runs")};
 
-    spdlog::info("Read numbers from {} and sort with {} workers", path, n_workers);
+    std::vector<fs::path> runs;
+    {
+        const mapped_file file{path};
+        file.advise_sequential();
+        LABS_TRACE_COUNT(bytes, file.size());
+        std::vector<int> numbers;
+        numbers.reserve(run_capacity);
 
-    std::ifstream file{path};
-    std::string line;
-    std::vector<int> numbers;
-    while (std::getline(file, line, ',')) {
-        numbers.emplace_back(std::stoi(line));
+        auto spill = [&] {
+            merge_sort(numbers, n_workers);
+            LABS_TRACE_SCOPE("spill");
+            auto const & run = runs.emplace_back(runs_dir.path() / fmt::format("{}.bin", runs.size()));
+            std::ofstream out{run, std::ios::binary};
+            write_checked(out, reinterpret_cast<char const *>(numbers.data()), numbers.size() * sizeof(int), run);
+            out.close();
+            if (!out) {
+                throw std::runtime_error(fmt::format("failed to write {}", run));
+            }
+            LABS_TRACE_COUNT(bytes, numbers.size() * sizeof(int));
+            numbers.clear();
+        };
+
+        // Mapped pages are clean page cache, the kernel drops them again under memory pressure
+        auto text = file.text();
+        while (!text.empty()) {
+            {
+                LABS_TRACE_SCOPE("parse");
+                const auto offset = static_cast<std::size_t>(text.data() - file.text().data());
+                text.remove_prefix(parse_ints(text, numbers, run_capacity, offset));
+            }
+            if (!numbers.empty()) {
+                spill();
+            }
+        }
     }
+    spdlog::info("{} sorted runs spilled to {}", runs.size(), runs_dir.path());
 
-    const auto start = std::chrono::high_resolution_clock::now();
+    // A formatted number takes at most 12 bytes with its separator
+    constexpr std::size_t max_number_chars = 12;
+    const auto output_bytes = std::max<std::size_t>(memory_budget / 4, max_number_chars);
+    const auto buffer_elems = std::max<std::size_t>((memory_budget - std::min(memory_budget, output_bytes)) / std::max<std::size_t>(runs.size(), 1) / sizeof(int), 1);
+    std::vector<run_reader> readers;
+    readers.reserve(runs.size());
+    for (auto const & run : runs) {
+        readers.emplace_back(run, buffer_elems);
+    }
 
-    merge_sort(numbers, n_workers);
+    using head = std::pair<int, std::size_t>; // (value, run)
+    std::priority_queue<head, std::vector<head>, std::greater<>> heap;
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+        int value;
+        if (readers[i].next(value)) {
+            heap.emplace(value, i);
+        }
+    }
 
-    const auto finish = std::chrono::high_resolution_clock::now();
-    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+    LABS_TRACE_SCOPE("kway_merge");
+    std::ofstream out{out_path, std::ios::binary};
+    if (!out) {
+        throw std::runtime_error(fmt::format("failed to open {}", out_path));
+    }
+    std::string buffer;
+    buffer.reserve(output_bytes);
+    bool first = true;
+    while (!heap.empty()) {
+        const auto [value, i] = heap.top();
+        heap.pop();
 
-    std::ofstream sorted{fmt::format("{}.sorted", path)};
-    sorted << fmt::format("{}", fmt::join(numbers, ","));
+        if (buffer.size() + max_number_chars > output_bytes) {
+            write_checked(out, buffer.data(), buffer.size(), out_path);
+            buffer.clear();
+        }
+        if (!first) {
+            buffer += ',';
+        }
+        first = false;
+        buffer += fmt::format_int(value).str();
 
-    spdlog::info("elapsed: {}mcs {} workers", elapsed, n_workers);
-    spdlog::info("{} hw cores", std::thread::hardware_concurrency());
+        int next;
+        if (readers[i].next(next)) {
+            heap.emplace(next, i);
+        }
+    }
+    write_checked(out, buffer.data(), buffer.size(), out_path);
+    out.close();
+    if (!out) {
+        throw std::runtime_error(fmt::format("failed to write {}", out_path));
+    }
 }
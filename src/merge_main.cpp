@@ -0,0 +1,73 @@
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/std.h>
+
+#include <int_parser.hpp>
+#include <merge.hpp>
+#include <trace.hpp>
+
+int main(int argc, char** argv)
+{
+    LABS_TRACE_SESSION("merge");
+    const std::string path = argv[1];
+    const std::size_t n_workers = std::stoull(argv[2]);
+
+    if (argc > 4 && std::string_view{argv[3]} == "--external") {
+        const std::size_t memory_budget = std::stoull(argv[4]) << 20;
+        spdlog::info("Sort {} out of core with {} workers and {}MiB of memory", path, n_workers, memory_budget >> 20);
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        try {
+            external_sort(path, fmt::format("{}.sorted", path), n_workers, memory_budget);
+        }
+        catch (std::exception const & e) {
+            spdlog::error("{}", e.what());
+            return 1;
+        }
+        const auto finish = std::chrono::high_resolution_clock::now();
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+
+        spdlog::info("elapsed: {}mcs {} workers (including I/O)", elapsed, n_workers);
+        spdlog::info("{} hw cores", std::thread::hardware_concurrency());
+        return 0;
+    }
+
+    spdlog::info("Read numbers from {} and sort with {} workers", path, n_workers);
+
+    const auto parse_start = std::chrono::high_resolution_clock::now();
+    std::vector<int> numbers;
+    try {
+        numbers = parse_int_file(path, n_workers);
+    }
+    catch (std::exception const & e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+    const auto parse_finish = std::chrono::high_resolution_clock::now();
+    const auto parse_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(parse_finish - parse_start).count();
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    try {
+        merge_sort(numbers, n_workers);
+    }
+    catch (std::exception const & e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+    const auto finish = std::chrono::high_resolution_clock::now();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+
+    std::ofstream sorted{fmt::format("{}.sorted", path)};
+    sorted << fmt::format("{}", fmt::join(numbers, ","));
+
+    spdlog::info("parsed {} numbers in {}mcs", numbers.size(), parse_elapsed);
+    spdlog::info("elapsed: {}mcs {} workers", elapsed, n_workers);
+    spdlog::info("{} hw cores", std::thread::hardware_concurrency());
+}
@@ -2,61 +2,261 @@
 #include <vector>
 #include <thread>
 #include <random>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <utility>
 
 #include <spdlog/spdlog.h>
 
 #include <monte_carlo.hpp>
+#include <parallel_reduce.hpp>
+#include <philox.hpp>
 
-double monte_carlo_pi(std::size_t n_points, std::size_t n_workers) {
-    spdlog::info("Solve Pi with Monte-Carlo: points={} workers={}", n_points, n_workers);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MC_MULTIVERSION 1
+#define MC_TARGET(isa) __attribute__((target(isa)))
+#define MC_INLINE __attribute__((always_inline)) inline
+#else
+#define MC_TARGET(isa)
+#define MC_INLINE inline
+#endif
 
-    std::atomic<std::uint64_t> points_in_circle{0};
-    const auto points_per_thread = n_points / n_workers;
-    const auto points_per_last_thread = points_per_thread + n_points % n_workers;
+namespace {
 
-    auto compute = [&](std::uint64_t points) {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<double> dist(0.0, 1.0);
+// One Philox block yields two points: (w0, w1) and (w2, w3). Coordinates keep 31 bits, so
+// x^2 + y^2 <= 1 is the exact integer test X^2 + Y^2 <= 2^62 with no overflow or rounding.
+inline std::uint64_t in_circle(std::uint32_t wx, std::uint32_t wy)
+{
+    const std::uint64_t x = wx >> 1;
+    const std::uint64_t y = wy >> 1;
+    return x * x + y * y <= (std::uint64_t{1} << 62) ? 1 : 0;
+}
+
+// Blocks per batch: 8 blocks = 16 points, the lane loops below are written to be auto-vectorized
+constexpr std::size_t lanes = 8;
+
+// Forced inline so each MC_TARGET wrapper below gets its own copy compiled for its instruction set
+MC_INLINE std::uint64_t count_blocks_impl(std::uint64_t seed, std::uint64_t first_block, std::uint64_t n_blocks)
+{
+    const auto key0 = static_cast<std::uint32_t>(seed);
+    const auto key1 = static_cast<std::uint32_t>(seed >> 32);
 
-        std::uint64_t point_count = 0;
+    std::uint64_t inside = 0;
+    std::uint64_t b = 0;
+    for (; b + lanes <= n_blocks; b += lanes) {
+        std::uint32_t c0[lanes], c1[lanes], c2[lanes], c3[lanes];
+        for (std::size_t l = 0; l < lanes; ++l) {
+            const auto counter = first_block + b + l;
+            c0[l] = static_cast<std::uint32_t>(counter);
+            c1[l] = static_cast<std::uint32_t>(counter >> 32);
+            c2[l] = 0;
+            c3[l] = 0;
+        }
 
-        for (int i = 0; i < points; ++i) {
-            const double x = dist(gen);
-            const double y = dist(gen);
-            if (x * x + y * y <= 1.0) {
-                ++point_count;
+        std::uint32_t k0 = key0;
+        std::uint32_t k1 = key1;
+        for (int r = 0; r < philox::rounds; ++r) {
+            for (std::size_t l = 0; l < lanes; ++l) {
+                philox::round(c0[l], c1[l], c2[l], c3[l], k0, k1);
             }
+            k0 += philox::W0;
+            k1 += philox::W1;
         }
 
-        points_in_circle.fetch_add(point_count);
-    };
+        for (std::size_t l = 0; l < lanes; ++l) {
+            inside += in_circle(c0[l], c1[l]) + in_circle(c2[l], c3[l]);
+        }
+    }
 
-    std::vector<std::thread> threads;
-    for (std::size_t i = 0; i < n_workers - 1; ++i) {
-        threads.emplace_back([&]{ compute(points_per_thread); });
+    for (; b < n_blocks; ++b) {
+        const auto w = philox::generate(seed, first_block + b);
+        inside += in_circle(w[0], w[1]) + in_circle(w[2], w[3]);
     }
+    return inside;
+}
 
-    compute(points_per_last_thread);
+#ifdef MC_MULTIVERSION
+MC_TARGET("avx512f")
+std::uint64_t count_blocks_avx512(std::uint64_t seed, std::uint64_t first_block, std::uint64_t n_blocks)
+{
+    return count_blocks_impl(seed, first_block, n_blocks);
+}
+
+MC_TARGET("avx2")
+std::uint64_t count_blocks_avx2(std::uint64_t seed, std::uint64_t first_block, std::uint64_t n_blocks)
+{
+    return count_blocks_impl(seed, first_block, n_blocks);
+}
+#endif
 
-    for (auto & t : threads) {
-        t.join();
+std::uint64_t count_blocks_default(std::uint64_t seed, std::uint64_t first_block, std::uint64_t n_blocks)
+{
+    return count_blocks_impl(seed, first_block, n_blocks);
+}
+
+using count_blocks_fn = std::uint64_t (*)(std::uint64_t, std::uint64_t, std::uint64_t);
+
+count_blocks_fn select_count_blocks()
+{
+#ifdef MC_MULTIVERSION
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return count_blocks_avx512;
+    if (__builtin_cpu_supports("avx2")) return count_blocks_avx2;
+#endif
+    return count_blocks_default;
+}
+
+// Points [first, last) of the stream: point p is half p % 2 of Philox block p / 2
+std::uint64_t count_points(std::uint64_t seed, std::uint64_t first, std::uint64_t last)
+{
+    static const auto count_blocks = select_count_blocks();
+
+    std::uint64_t inside = 0;
+    if (first < last && first % 2 == 1) {
+        const auto w = philox::generate(seed, first / 2);
+        inside += in_circle(w[2], w[3]);
+        ++first;
+    }
+    if (first < last && last % 2 == 1) {
+        const auto w = philox::generate(seed, last / 2);
+        inside += in_circle(w[0], w[1]);
+        --last;
+    }
+    if (first < last) {
+        inside += count_blocks(seed, first / 2, (last - first) / 2);
     }
+    return inside;
+}
+
+} // namespace
+
+double monte_carlo_pi(std::size_t n_points, std::size_t n_workers, std::uint64_t seed) {
+    spdlog::info("Solve Pi with Monte-Carlo: points={} workers={} seed={}", n_points, n_workers, seed);
+
+    // Every point has a fixed place in the Philox stream, so the estimate depends only on (seed, n_points)
+    auto & pool = persistent_pool(n_workers);
+    const auto points_in_circle = parallel_reduce(pool, 0, n_points, std::uint64_t{0},
+        [&](std::size_t first, std::size_t last) { return count_points(seed, first, last); },
+        std::plus<>{}, 1 << 16);
 
     const double pi_estimate = 4.0 * points_in_circle / n_points;
     return pi_estimate;
 }
 
-int main(int argc, char** argv)
-{
-    const std::size_t n_points = std::stoull(argv[1]);
-    const std::size_t n_workers = std::stoull(argv[2]);
-    const auto n_cores = std::thread::hardware_concurrency(); 
+// Streaming mode: point batches are interleaved between workers (worker w takes batches w, w + n, ...),
+// and each worker publishes running totals into its own cache line, so nothing is shared on the hot path
+monte_carlo_result monte_carlo_pi(double tolerance, std::size_t n_workers, std::uint64_t seed, std::uint64_t max_points) {
+    spdlog::info("Solve Pi with Monte-Carlo until std error <= {}: max points={} workers={} seed={}", tolerance, max_points, n_workers, seed);
+    if (n_workers == 0) {
+        throw std::invalid_argument("streaming Monte-Carlo needs at least one worker");
+    }
+
+    constexpr std::uint64_t batch_points = 1 << 20;
+    constexpr auto poll_interval = std::chrono::milliseconds(5);
+    constexpr auto report_interval = std::chrono::seconds(1);
+
+    // Running totals of one worker behind a seqlock: the worker makes version odd while it updates the
+    // pair, so a reader retries instead of pairing points of one batch with hits of the next
+    struct alignas(64) partial
+    {
+        std::atomic<std::uint64_t> version{0};
+        std::atomic<std::uint64_t> points{0};
+        std::atomic<std::uint64_t> inside{0};
+
+        void publish(std::uint64_t new_points, std::uint64_t new_inside)
+        {
+            const auto v = version.load(std::memory_order_relaxed);
+            version.store(v + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            points.store(new_points, std::memory_order_relaxed);
+            inside.store(new_inside, std::memory_order_relaxed);
+            version.store(v + 2, std::memory_order_release);
+        }
+
+        std::pair<std::uint64_t, std::uint64_t> snapshot() const
+        {
+            for (;;) {
+                const auto before = version.load(std::memory_order_acquire);
+                const auto p = points.load(std::memory_order_relaxed);
+                const auto i = inside.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (before % 2 == 0 && version.load(std::memory_order_relaxed) == before) {
+                    return {p, i};
+                }
+            }
+        }
+    };
+
+    std::vector<partial> partials(n_workers);
+    std::atomic<bool> stop{false};
+
+    auto worker = [&](std::size_t w) {
+        std::uint64_t points = 0;
+        std::uint64_t inside = 0;
+        for (std::uint64_t first = w * batch_points; first < max_points && !stop.load(std::memory_order_relaxed); first += n_workers * batch_points) {
+            const auto last = std::min(first + batch_points, max_points);
+            inside += count_points(seed, first, last);
+            points += last - first;
+            partials[w].publish(points, inside);
+        }
+    };
+
+    // One long-running block per worker; the calling thread polls the partials meanwhile
+    auto & pool = persistent_pool(n_workers);
+    auto workers_done = pool.submit_loop<std::size_t>(0, n_workers, worker, n_workers);
+
+    monte_carlo_result res{};
+    const auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+    std::uint64_t last_report_points = 0;
+
+    auto estimate = [&] {
+        std::uint64_t points = 0;
+        std::uint64_t inside = 0;
+        for (auto const & p : partials) {
+            const auto [p_points, p_inside] = p.snapshot();
+            points += p_points;
+            inside += p_inside;
+        }
+        if (points > 0) {
+            const double hit_rate = static_cast<double>(inside) / points;
+            res.pi = 4.0 * hit_rate;
+            res.std_error = 4.0 * std::sqrt(hit_rate * (1.0 - hit_rate) / points);
+            res.n_points = points;
+        }
+        res.elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return points;
+    };
+
+    for (;;) {
+        std::this_thread::sleep_for(poll_interval);
+
+        const auto points = estimate();
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= report_interval) {
+            const auto rate = (points - last_report_points) / std::chrono::duration<double>(now - last_report).count();
+            spdlog::info("t={:.1f}s points={} PI={} std error={:.3g} ({:.3g} points/s)", res.elapsed_sec, points, res.pi, res.std_error, rate);
+            last_report = now;
+            last_report_points = points;
+        }
+
+        const bool converged = points >= batch_points && res.std_error <= tolerance;
+        if (converged || points >= max_points) {
+            stop.store(true, std::memory_order_relaxed);
+            break;
+        }
+    }
 
-    const auto start = std::chrono::high_resolution_clock::now();
-    const auto pi_estimate = monte_carlo_pi(n_points, n_workers);
-    const auto finish = std::chrono::high_resolution_clock::now();
-    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count();
+    // Batches finished after the last poll count too: the result is the final totals of all workers
+    workers_done.wait();
+    estimate();
 
-    spdlog::info("PI={} points={} workers={} cores={} time={}", pi_estimate, n_points, n_workers, n_cores, elapsed);
+    return res;
 }
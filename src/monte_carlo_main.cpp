@@ -0,0 +1,70 @@
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+#include <monte_carlo.hpp>
+
+int main(int argc, char** argv)
+{
+    const std::size_t n_points = std::stoull(argv[1]);
+    const std::size_t n_workers = std::stoull(argv[2]);
+    std::optional<std::uint64_t> seed;
+    std::optional<double> tolerance;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        std::uint64_t value{};
+        const auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+        if (arg == "--tolerance" && i + 1 < argc) {
+            const std::string_view text = argv[++i];
+            double t{};
+            const auto [t_end, t_ec] = std::from_chars(text.data(), text.data() + text.size(), t);
+            if (t_ec != std::errc{} || t_end != text.data() + text.size() || !std::isfinite(t) || t <= 0) {
+                spdlog::error("--tolerance must be a positive number, got {}", text);
+                return 1;
+            }
+            tolerance = t;
+        }
+        else if (!seed && !arg.empty() && ec == std::errc{} && end == arg.data() + arg.size()) {
+            seed = value;
+        }
+        else {
+            spdlog::error("unknown argument: {}", arg);
+            return 1;
+        }
+    }
+    if (!seed) {
+        seed = std::random_device{}();
+    }
+    const auto n_cores = std::thread::hardware_concurrency(); 
+
+    if (tolerance) {
+        monte_carlo_result res;
+        try {
+            res = monte_carlo_pi(*tolerance, n_workers, *seed, n_points);
+        }
+        catch (std::exception const & e) {
+            spdlog::error("{}", e.what());
+            return 1;
+        }
+        spdlog::info("PI={} std error={:.3g} points={} workers={} cores={} time={:.0f} ({:.3g} points/s)",
+            res.pi, res.std_error, res.n_points, n_workers, n_cores, res.elapsed_sec * 1000, res.n_points / res.elapsed_sec);
+        return 0;
+    }
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    const auto pi_estimate = monte_carlo_pi(n_points, n_workers, *seed);
+    const auto finish = std::chrono::high_resolution_clock::now();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count();
+    const auto points_per_sec = n_points / std::chrono::duration<double>(finish - start).count();
+
+    spdlog::info("PI={} points={} workers={} cores={} time={} ({:.3g} points/s)", pi_estimate, n_points, n_workers, n_cores, elapsed, points_per_sec);
+}
@@ -0,0 +1,207 @@
+#include <parallel_mul.hpp>
+#include <trace.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Toom-k state of one product. Point 0 is x = 0, point 1 is x = infinity, the rest are the finite
+// nonzero points 1, -1, 2, -2, ...; values[j] ends up holding a(x_j) * b(x_j).
+struct toom_product
+{
+    mul_job job;
+    std::size_t k;
+    std::size_t m; // limbs per piece
+    std::vector<__mpz_struct> a_pieces;
+    std::vector<__mpz_struct> b_pieces;
+    std::vector<long> points;
+    std::vector<mpz_class> values;
+};
+
+// Pieces of |x| as read-only views over its limbs, piece i holds limbs [i * m, (i + 1) * m)
+std::vector<__mpz_struct> split(mpz_class const & x, std::size_t k, std::size_t m)
+{
+    const auto limbs = mpz_limbs_read(x.get_mpz_t());
+    const auto n = mpz_size(x.get_mpz_t());
+
+    std::vector<__mpz_struct> pieces(k);
+    for (std::size_t i = 0; i < k; ++i) {
+        const auto begin = std::min(n, i * m);
+        const auto end = std::min(n, begin + m);
+        mpz_roinit_n(&pieces[i], limbs + begin, static_cast<mp_size_t>(end - begin));
+    }
+    return pieces;
+}
+
+mpz_class evaluate(std::vector<__mpz_struct> const & pieces, long x)
+{
+    mpz_class v{&pieces.back()};
+    for (auto i = pieces.size() - 1; i-- > 0;) {
+        mpz_mul_si(v.get_mpz_t(), v.get_mpz_t(), x);
+        mpz_add(v.get_mpz_t(), v.get_mpz_t(), &pieces[i]);
+    }
+    return v;
+}
+
+void divexact(mpz_class & v, long d)
+{
+    mpz_divexact_ui(v.get_mpz_t(), v.get_mpz_t(), static_cast<unsigned long>(std::labs(d)));
+    if (d < 0) {
+        v = -v;
+    }
+}
+
+void pointwise(toom_product & t, std::size_t j)
+{
+    if (j == 0) {
+        mpz_mul(t.values[0].get_mpz_t(), &t.a_pieces.front(), &t.b_pieces.front());
+        return;
+    }
+    if (j == 1) {
+        mpz_mul(t.values[1].get_mpz_t(), &t.a_pieces.back(), &t.b_pieces.back());
+        return;
+    }
+
+    const auto x = t.points[j - 2];
+    const auto a = evaluate(t.a_pieces, x);
+    if (t.job.a == t.job.b) {
+        t.values[j] = a * a;
+    }
+    else {
+        t.values[j] = a * evaluate(t.b_pieces, x);
+    }
+}
+
+// Recovers the 2k - 1 coefficients of the product polynomial from its values and recomposes them.
+// The two ends are known directly; the middle ones come from Newton interpolation of
+// (r(x) - c_0 - c_top x^top) / x over the finite points, where every division is exact.
+void interpolate(toom_product & t)
+{
+    const auto top = 2 * t.k - 2;
+    const auto n = t.points.size();
+    auto const & c0 = t.values[0];
+    auto const & c_top = t.values[1];
+
+    std::vector<mpz_class> d(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto x = t.points[i];
+        mpz_class x_top;
+        mpz_ui_pow_ui(x_top.get_mpz_t(), static_cast<unsigned long>(std::labs(x)), static_cast<unsigned long>(top));
+        d[i] = t.values[i + 2] - c0 - c_top * x_top;
+        divexact(d[i], x);
+    }
+
+    // Divided differences in place: d[i] becomes q[x_0, ..., x_i]
+    for (std::size_t lvl = 1; lvl < n; ++lvl) {
+        for (auto i = n - 1; i >= lvl; --i) {
+            d[i] -= d[i - 1];
+            divexact(d[i], t.points[i] - t.points[i - lvl]);
+        }
+    }
+
+    // Newton form to monomial coefficients, Horner style from the highest difference down
+    std::vector<mpz_class> coef(n);
+    coef[0] = d[n - 1];
+    for (auto j = n - 1; j-- > 0;) {
+        const auto x = t.points[j];
+        for (auto i = n - 1 - j; i > 0; --i) {
+            coef[i] = coef[i - 1] - coef[i] * x;
+        }
+        coef[0] = d[j] - coef[0] * x;
+    }
+
+    const auto shift = t.m * GMP_NUMB_BITS;
+    mpz_class result = c_top;
+    for (auto i = top; i-- > 1;) {
+        result <<= shift;
+        result += coef[i - 1];
+    }
+    result <<= shift;
+    result += c0;
+
+    if (sgn(*t.job.a) * sgn(*t.job.b) < 0) {
+        result = -result;
+    }
+    *t.job.out = std::move(result);
+}
+
+// Every task finishes before the first exception is rethrown: the tasks still write into the products
+void wait_all(std::vector<task_future<void>> & futures)
+{
+    join_all(futures);
+    futures.clear();
+}
+
+} // namespace
+
+void parallel_multiply(thread_pool & pool, std::span<mul_job const> jobs)
+{
+    const auto n_threads = pool.get_thread_count();
+
+    std::size_t n_large = 0;
+    for (auto const & job : jobs) {
+        if (std::max(mpz_size(job.a->get_mpz_t()), mpz_size(job.b->get_mpz_t())) >= toom_threshold_limbs) {
+            ++n_large;
+        }
+    }
+    // 2k - 1 pointwise products per large job, about n_threads tasks for the batch
+    const auto k = n_large == 0 ? 0 : std::max<std::size_t>(2, (n_threads / n_large + 1) / 2);
+
+    std::vector<std::unique_ptr<toom_product>> products;
+    std::vector<task_future<void>> futures;
+    // Reserved up front so no future of a running task is lost to a reallocation that throws
+    futures.reserve(n_threads < 2 ? jobs.size() : jobs.size() + n_large * (2 * k - 2));
+    // Splitting the next job can throw while earlier tasks already run against the products
+    try {
+        for (auto const & job : jobs) {
+            const auto n = std::max(mpz_size(job.a->get_mpz_t()), mpz_size(job.b->get_mpz_t()));
+            LABS_TRACE_COUNT(elements, mpz_size(job.a->get_mpz_t()) + mpz_size(job.b->get_mpz_t()));
+            if (n < toom_threshold_limbs || n_threads < 2) {
+                futures.emplace_back(pool.submit_task([job]{
+                    LABS_TRACE_SCOPE("mul");
+                    *job.out = *job.a * *job.b;
+                }));
+                continue;
+            }
+
+            auto t = std::make_unique<toom_product>();
+            t->job = job;
+            t->k = k;
+            t->m = (n + k - 1) / k;
+            t->a_pieces = split(*job.a, k, t->m);
+            t->b_pieces = job.a == job.b ? t->a_pieces : split(*job.b, k, t->m);
+            for (long x = 1; t->points.size() < 2 * k - 3; x = x > 0 ? -x : -x + 1) {
+                t->points.push_back(x);
+            }
+            t->values.resize(2 * k - 1);
+            products.push_back(std::move(t));
+
+            auto * p = products.back().get();
+            for (std::size_t j = 0; j < p->values.size(); ++j) {
+                futures.emplace_back(pool.submit_task([p, j]{
+                    LABS_TRACE_SCOPE("toom_pointwise");
+                    pointwise(*p, j);
+                }));
+            }
+        }
+    }
+    catch (...) {
+        for (auto & f : futures) {
+            f.wait();
+        }
+        throw;
+    }
+    LABS_TRACE_COUNT(tasks, futures.size() + products.size());
+    wait_all(futures);
+
+    for (auto & t : products) {
+        futures.emplace_back(pool.submit_task([p = t.get()]{
+            LABS_TRACE_SCOPE("toom_interpolate");
+            interpolate(*p);
+        }));
+    }
+    wait_all(futures);
+}
@@ -0,0 +1,772 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include <nlohmann/json.hpp>
+
+#include <big_decimal.hpp>
+#include <bfs.hpp>
+#include <cannon.hpp>
+#include <fibonacci.hpp>
+#include <gemm.hpp>
+#include <int_parser.hpp>
+#include <max.hpp>
+#include <merge.hpp>
+#include <monte_carlo.hpp>
+#include <parallel_mul.hpp>
+#include <philox.hpp>
+#include <thread_pool.hpp>
+#include <wc.hpp>
+
+// Correctness tests of every lab's entry points against naive references, on small synthetic inputs
+// and several worker counts. Each case throws on its first mismatch.
+//
+//   labs-tests [lab]   runs the cases of one lab (cannon, monte-carlo, merge, max, wc, bfs, fib), or all
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void expect(bool ok, std::string const & what)
+{
+    if (!ok) {
+        throw std::runtime_error(what);
+    }
+}
+
+template <typename F>
+void expect_throws(F && f, std::string const & what)
+{
+    try {
+        f();
+    }
+    catch (std::exception const &) {
+        return;
+    }
+    throw std::runtime_error(what + " did not throw");
+}
+
+const std::vector<std::size_t> worker_counts{1, 2, 3, 8};
+
+std::vector<int> random_ints(std::size_t n, int lo, int hi, std::uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> dist(lo, hi);
+    std::vector<int> v(n);
+    for (auto & x : v) {
+        x = dist(rng);
+    }
+    return v;
+}
+
+// Private directory under the system temp directory, removed with everything in it
+class temp_dir
+{
+public:
+    temp_dir()
+    {
+        std::random_device rd;
+        do {
+            path_ = fs::temp_directory_path() / fmt::format("parallel-labs-test-{:08x}", rd());
+        } while (!fs::create_directory(path_));
+    }
+
+    ~temp_dir()
+    {
+        std::error_code ec;
+        fs::remove_all(path_, ec);
+    }
+
+    temp_dir(temp_dir const &) = delete;
+    temp_dir & operator=(temp_dir const &) = delete;
+
+    fs::path const & path() const { return path_; }
+
+private:
+    fs::path path_;
+};
+
+void write_file(fs::path const & path, std::string_view text)
+{
+    std::ofstream{path, std::ios::binary} << text;
+}
+
+std::string read_file(fs::path const & path)
+{
+    std::ifstream file{path, std::ios::binary};
+    return {std::istreambuf_iterator<char>(file), {}};
+}
+
+std::string join_ints(std::span<int const> v, std::string_view sep)
+{
+    return fmt::format("{}", fmt::join(v, sep));
+}
+
+// Cannon
+
+template <typename T>
+std::vector<T> naive_matmul(std::vector<T> const & A, std::vector<T> const & B, std::size_t m, std::size_t n, std::size_t k)
+{
+    std::vector<T> C(m * n);
+    for (std::size_t i = 0; i < m; ++i) {
+        for (std::size_t p = 0; p < k; ++p) {
+            for (std::size_t j = 0; j < n; ++j) {
+                C[i * n + j] += A[i * k + p] * B[p * n + j];
+            }
+        }
+    }
+    return C;
+}
+
+// Small integer entries, so float and double products are exact and compare equal
+template <typename T>
+std::vector<T> small_matrix(std::size_t n, std::uint64_t seed)
+{
+    const auto ints = random_ints(n, -3, 3, seed);
+    return std::vector<T>(ints.begin(), ints.end());
+}
+
+template <typename T>
+void test_block_gemm()
+{
+    for (auto [m, n, k] : {std::array<std::size_t, 3>{1, 1, 1}, {7, 13, 5}, {100, 37, 300}, {130, 1100, 270}}) {
+        const auto A = small_matrix<T>(m * k, 1);
+        const auto B = small_matrix<T>(k * n, 2);
+        std::vector<T> C(m * n, T{1});
+        block_gemm<T>(A.data(), k, B.data(), n, C.data(), n, m, n, k);
+
+        auto expected = naive_matmul(A, B, m, n, k);
+        for (auto & x : expected) {
+            x += T{1};
+        }
+        expect(C == expected, fmt::format("block_gemm {}x{}x{} ({})", m, n, k, gemm_isa_name(detect_gemm_isa())));
+    }
+}
+
+template <typename T>
+void test_cannon_multiply()
+{
+    for (const std::size_t N : {1, 5, 64, 100}) {
+        const auto A = small_matrix<T>(N * N, 3);
+        const auto B = small_matrix<T>(N * N, 4);
+        const auto expected = naive_matmul(A, B, N, N, N);
+        for (const auto shift : {cannon_shift::tiles, cannon_shift::reference}) {
+            for (const std::size_t block_size : {0, 7}) {
+                for (const auto w : worker_counts) {
+                    std::vector<T> C(N * N, T{42});
+                    cannon_multiply<T>(A, B, C, N, block_size, w, shift);
+                    expect(C == expected, fmt::format("cannon_multiply N={} block={} workers={} {}", N, block_size, w, cannon_shift_name(shift)));
+                }
+            }
+        }
+    }
+}
+
+// Monte-Carlo
+
+void test_philox()
+{
+    // Known-answer vector of the Random123 reference implementation, counter and key all zero
+    const auto out = philox::generate(0, 0);
+    expect(out == std::array<std::uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}, "philox4x32-10 known answer");
+    expect(philox::generate(1, 0) != out && philox::generate(0, 1) != out, "philox streams differ by key and counter");
+}
+
+void test_monte_carlo_pi()
+{
+    constexpr std::size_t n_points = 1 << 20;
+    const auto pi = monte_carlo_pi(n_points, 1, 7);
+    expect(std::abs(pi - 3.14159265358979) < 0.01, fmt::format("monte_carlo_pi estimate {}", pi));
+    for (const auto w : worker_counts) {
+        expect(monte_carlo_pi(n_points, w, 7) == pi, fmt::format("monte_carlo_pi with {} workers differs from 1 worker", w));
+    }
+    // Counts that don't split evenly over the workers
+    expect(monte_carlo_pi(n_points + 13, 3, 7) == monte_carlo_pi(n_points + 13, 1, 7), "monte_carlo_pi with an uneven split");
+}
+
+void test_monte_carlo_stream()
+{
+    const double tolerance = 5e-3;
+    const auto res = monte_carlo_pi(tolerance, 3, 11, std::uint64_t{1} << 24);
+    expect(res.std_error <= tolerance || res.n_points == std::uint64_t{1} << 24, "streaming mode stopped early");
+    expect(std::abs(res.pi - 3.14159265358979) < 6 * res.std_error, fmt::format("streaming estimate {} +- {}", res.pi, res.std_error));
+    expect_throws([] { monte_carlo_pi(1e-3, 0, 1); }, "streaming mode with 0 workers");
+}
+
+// Merge sort
+
+void test_merge_sort()
+{
+    for (const std::size_t n : {0, 1, 2, 17, 1000, 100003}) {
+        for (const auto & [lo, hi] : {std::pair{-5, 5}, std::pair{-1'000'000'000, 1'000'000'000}}) {
+            const auto input = random_ints(n, lo, hi, n);
+            auto expected = input;
+            std::sort(expected.begin(), expected.end());
+            for (const auto w : worker_counts) {
+                auto numbers = input;
+                merge_sort(numbers, w);
+                expect(numbers == expected, fmt::format("merge_sort n={} range=[{}, {}] workers={}", n, lo, hi, w));
+            }
+        }
+    }
+    expect_throws([] { std::vector<int> numbers{3, 1, 2}; merge_sort(numbers, 0); }, "merge_sort with 0 workers");
+}
+
+void test_external_sort()
+{
+    temp_dir dir;
+    const auto input = random_ints(50000, -1'000'000, 1'000'000, 5);
+    auto expected = input;
+    std::sort(expected.begin(), expected.end());
+    write_file(dir.path() / "in.txt", join_ints(input, ","));
+
+    // Budgets from many short runs up to everything in one run
+    for (const std::size_t budget : {1 << 12, 1 << 16, 1 << 24}) {
+        for (const std::size_t w : {1, 3}) {
+            external_sort(dir.path() / "in.txt", dir.path() / "out.txt", w, budget);
+            const auto out = read_file(dir.path() / "out.txt");
+            expect(out == join_ints(expected, ","), fmt::format("external_sort budget={} workers={}", budget, w));
+        }
+    }
+    expect_throws([&] { external_sort(dir.path() / "in.txt", dir.path() / "out.txt", 0, 1 << 16); }, "external_sort with 0 workers");
+}
+
+// Max and the integer parser
+
+void test_int_parser()
+{
+    temp_dir dir;
+    const auto input = random_ints(100000, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 6);
+    write_file(dir.path() / "ints.txt", join_ints(input, ", \n"));
+    for (const auto w : worker_counts) {
+        expect(parse_int_file(dir.path() / "ints.txt", w) == input, fmt::format("parse_int_file workers={}", w));
+    }
+
+    write_file(dir.path() / "empty.txt", "");
+    expect(parse_int_file(dir.path() / "empty.txt", 3).empty(), "parse_int_file of an empty file");
+
+    write_file(dir.path() / "bad.txt", "1,2,3,x4,5");
+    for (const auto w : worker_counts) {
+        try {
+            parse_int_file(dir.path() / "bad.txt", w);
+            expect(false, "parse_int_file accepted malformed input");
+        }
+        catch (std::runtime_error const & e) {
+            expect(std::string_view{e.what()}.ends_with("at byte 6"), fmt::format("malformed input reported as \"{}\"", e.what()));
+        }
+    }
+    expect_throws([&] { parse_int_file(dir.path() / "ints.txt", 0); }, "parse_int_file with 0 workers");
+}
+
+void test_max()
+{
+    temp_dir dir;
+    for (const std::size_t n : {1, 7, 100003}) {
+        auto input = random_ints(n, -1'000'000, 1'000'000, n + 1);
+        const auto max_it = std::max_element(input.begin(), input.end());
+        std::int64_t sum = 0;
+        for (const auto x : input) {
+            sum += x;
+        }
+
+        for (const auto w : worker_counts) {
+            auto numbers = input;
+            expect(maximum(numbers, w) == *max_it, fmt::format("maximum n={} workers={}", n, w));
+        }
+
+        write_file(dir.path() / "ints.txt", join_ints(input, ","));
+        for (const auto w : worker_counts) {
+            const auto stats = stream_stats((dir.path() / "ints.txt").string(), w);
+            expect(stats.count == n && stats.max == *max_it && stats.min == *std::min_element(input.begin(), input.end()) && stats.sum == sum
+                && stats.argmax == static_cast<std::size_t>(max_it - input.begin()), fmt::format("stream_stats n={} workers={}", n, w));
+        }
+    }
+}
+
+// Word count
+
+using naive_counts = std::map<std::string, std::size_t>;
+
+// Words are maximal runs of anything but ',' and ' '
+naive_counts count_naive(std::string_view text)
+{
+    naive_counts counts;
+    std::string word;
+    for (const char c : text) {
+        if (c == ',' || c == ' ') {
+            if (!word.empty()) {
+                ++counts[word];
+            }
+            word.clear();
+        }
+        else {
+            word += c;
+        }
+    }
+    if (!word.empty()) {
+        ++counts[word];
+    }
+    return counts;
+}
+
+// By count descending, then word, as the histograms are ordered
+std::vector<std::pair<std::string, std::size_t>> ordered(naive_counts const & counts, std::size_t top_k = 0)
+{
+    std::vector<std::pair<std::string, std::size_t>> res(counts.begin(), counts.end());
+    std::stable_sort(res.begin(), res.end(), [](auto const & a, auto const & b) { return a.second > b.second; });
+    if (top_k != 0) {
+        res.resize(std::min(res.size(), top_k));
+    }
+    return res;
+}
+
+std::vector<std::pair<std::string, std::size_t>> to_pairs(word_histogram const & h)
+{
+    std::vector<std::pair<std::string, std::size_t>> res;
+    for (auto const & [word, count] : h.map) {
+        res.emplace_back(std::string(word), count);
+    }
+    return res;
+}
+
+std::string random_text(std::size_t n_words, std::uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> word(0, 300);
+    std::uniform_int_distribution<int> sep(0, 9);
+    std::string text;
+    for (std::size_t i = 0; i < n_words; ++i) {
+        text += fmt::format("w{}", word(rng) * word(rng) / 300);
+        const auto s = sep(rng);
+        text += s == 0 ? ",  " : s == 1 ? "\n" : s < 5 ? "," : " ";
+    }
+    return text;
+}
+
+class corpus
+{
+public:
+    explicit corpus(fs::path dir) : dir_{std::move(dir)} { fs::create_directories(dir_); }
+
+    void put(std::string const & name, std::string text)
+    {
+        write_file(dir_ / name, text);
+        files_[(dir_ / name).string()] = std::move(text);
+    }
+
+    void remove(std::string const & name)
+    {
+        fs::remove(dir_ / name);
+        files_.erase((dir_ / name).string());
+    }
+
+    fs::path const & dir() const { return dir_; }
+
+    naive_counts file_counts(std::string const & path) const { return count_naive(files_.at(path)); }
+
+    naive_counts total_counts() const
+    {
+        naive_counts total;
+        for (auto const & [path, text] : files_) {
+            for (auto const & [word, count] : count_naive(text)) {
+                total[word] += count;
+            }
+        }
+        return total;
+    }
+
+    // Per-file histograms in whatever order they come, each matched by its file
+    void expect_files(std::vector<word_histogram> const & hists, std::size_t top_k, std::string const & what) const
+    {
+        expect(hists.size() == files_.size(), fmt::format("{}: {} histograms for {} files", what, hists.size(), files_.size()));
+        for (auto const & h : hists) {
+            expect(to_pairs(h) == ordered(file_counts(h.file.string()), top_k), fmt::format("{}: histogram of {}", what, h.file.string()));
+        }
+    }
+
+    void expect_corpus(std::vector<word_histogram> const & hists, std::size_t top_k, std::string const & what) const
+    {
+        expect(hists.size() == 1 && to_pairs(hists[0]) == ordered(total_counts(), top_k), what);
+    }
+
+private:
+    fs::path dir_;
+    std::map<std::string, std::string> files_;
+};
+
+void test_wc()
+{
+    temp_dir dir;
+    corpus c{dir.path() / "corpus"};
+    for (std::size_t f = 0; f < 6; ++f) {
+        c.put(fmt::format("{}.txt", f), random_text(f == 0 ? 200000 : 500 * f, f));
+    }
+    c.put("empty.txt", "");
+    fs::create_directory(c.dir() / "subdir"); // not a regular file, skipped by every mode
+
+    for (const std::size_t top_k : {0, 5}) {
+        for (const auto w : worker_counts) {
+            c.expect_files(folder_word_histogram(c.dir(), w, top_k), top_k, fmt::format("folder_word_histogram workers={} top={}", w, top_k));
+            c.expect_corpus({corpus_word_histogram(c.dir(), w, top_k)}, top_k, fmt::format("corpus_word_histogram workers={} top={}", w, top_k));
+        }
+    }
+    c.expect_corpus({corpus_word_histogram(c.dir(), 0, 0)}, 0, "corpus_word_histogram with 0 workers");
+}
+
+void test_wc_index()
+{
+    temp_dir dir;
+    corpus c{dir.path() / "corpus"};
+    for (std::size_t f = 0; f < 5; ++f) {
+        c.put(fmt::format("{}.txt", f), random_text(2000 + 100 * f, 10 + f));
+    }
+    const auto files_index = dir.path() / "files.wcix";
+    const auto corpus_index = dir.path() / "corpus.wcix";
+
+    // Cold run, warm run without changes, then changed, added and deleted files; the index must always
+    // give what a full recount gives
+    auto check_all = [&](std::string const & step) {
+        for (const std::size_t top_k : {0, 3}) {
+            c.expect_files(incremental_histograms(c.dir(), 3, files_index, false, top_k), top_k, fmt::format("incremental files, {} top={}", step, top_k));
+            c.expect_corpus(incremental_histograms(c.dir(), 3, corpus_index, true, top_k), top_k, fmt::format("incremental corpus, {} top={}", step, top_k));
+        }
+    };
+    check_all("cold");
+    check_all("warm");
+
+    c.put("1.txt", random_text(3000, 99)); // different size, so the change is seen whatever the mtime granularity
+    c.put("new.txt", random_text(700, 100));
+    c.remove("3.txt");
+    check_all("after changes");
+
+    // Small changes are appended to the log, which is rewritten once superseded records dominate it
+    std::size_t appends = 0;
+    std::size_t rewrites = 0;
+    for (std::size_t round = 0; round < 6; ++round) {
+        const auto before = read_file(files_index);
+        c.put("0.txt", random_text(2100 + 10 * round, 200 + round));
+        if (round % 2 == 1) {
+            c.remove(fmt::format("extra{}.txt", round - 1));
+        }
+        else {
+            c.put(fmt::format("extra{}.txt", round), random_text(300, 300 + round));
+        }
+        check_all(fmt::format("change round {}", round));
+        const auto after = read_file(files_index);
+        after.size() > before.size() && after.starts_with(before) ? ++appends : ++rewrites;
+    }
+    expect(appends > 0 && rewrites > 0, fmt::format("index appended {} times and rewritten {} times", appends, rewrites));
+
+    // An append cut short leaves a torn batch at the end, which is ignored and then overwritten
+    for (auto const & index : {files_index, corpus_index}) {
+        std::ofstream{index, std::ios::binary | std::ios::app} << std::string("\xff\xff\xff\x7f\0\0\0\0torn", 12);
+    }
+    check_all("torn append");
+    c.put("2.txt", random_text(2500, 400));
+    check_all("change after a torn append");
+    for (auto const & index : {files_index, corpus_index}) {
+        expect(read_file(index).find("torn") == std::string::npos, fmt::format("torn batch left in {}", index.filename().string()));
+    }
+
+    write_file(files_index, "not an index");
+    c.expect_files(incremental_histograms(c.dir(), 2, files_index, false, 0), 0, "incremental files over a corrupt index");
+}
+
+// BFS
+
+// Random binary tree of nested {"value", "left", "right"} objects
+nlohmann::json random_tree(std::mt19937_64 & rng, std::size_t depth)
+{
+    std::uniform_int_distribution<int> value(-50, 50);
+    std::uniform_int_distribution<int> coin(0, 3);
+    nlohmann::json node{{"value", value(rng)}};
+    if (depth > 0) {
+        if (coin(rng) != 0) node["left"] = random_tree(rng, depth - 1);
+        if (coin(rng) != 0) node["right"] = random_tree(rng, depth - 1);
+    }
+    return node;
+}
+
+std::vector<std::vector<int>> json_levels(nlohmann::json const & root)
+{
+    std::vector<std::vector<int>> levels;
+    std::vector<nlohmann::json const *> level{&root};
+    while (!level.empty()) {
+        std::vector<nlohmann::json const *> next;
+        auto & values = levels.emplace_back();
+        for (auto const * node : level) {
+            values.push_back(node->at("value").get<int>());
+            for (auto const * key : {"left", "right"}) {
+                if (node->contains(key)) {
+                    next.push_back(&node->at(key));
+                }
+            }
+        }
+        level = std::move(next);
+    }
+    return levels;
+}
+
+void test_load_tree()
+{
+    temp_dir dir;
+    std::mt19937_64 rng(12);
+    for (const std::size_t depth : {0, 3, 14}) {
+        const auto root = random_tree(rng, depth);
+        write_file(dir.path() / "tree.json", root.dump(depth == 3 ? 4 : -1));
+        const auto tree = load_tree((dir.path() / "tree.json").string());
+        const auto expected = json_levels(root);
+
+        expect(tree.n_levels() == expected.size(), fmt::format("load_tree depth {}: {} levels", depth, tree.n_levels()));
+        for (std::size_t l = 0; l < expected.size(); ++l) {
+            expect(std::ranges::equal(tree.level(l), expected[l]), fmt::format("load_tree depth {}: level {}", depth, l));
+        }
+        // Children of every node are the next entries of the following level, in order
+        for (std::size_t i = 0; i < tree.size(); ++i) {
+            for (const auto child : {tree.left[i], tree.right[i]}) {
+                expect(child == flat_tree::npos || child > i, "load_tree: a child precedes its parent");
+            }
+        }
+    }
+
+    write_file(dir.path() / "bad.json", R"({"value": 1, "left": {"value": "x"}})");
+    expect_throws([&] { load_tree((dir.path() / "bad.json").string()); }, "load_tree of a non-numeric value");
+    write_file(dir.path() / "bad.json", R"({"value": 1, "left": )");
+    expect_throws([&] { load_tree((dir.path() / "bad.json").string()); }, "load_tree of truncated input");
+}
+
+void test_level_aggregates()
+{
+    // Above the reduce grain, so the blocks really run in parallel; the values keep the exact product short
+    std::mt19937_64 rng(13);
+    std::uniform_int_distribution<int> pick(0, 999);
+    std::vector<int> values(200000);
+    for (auto & v : values) {
+        const auto p = pick(rng);
+        v = p == 0 ? 2 : p == 1 ? -3 : p < 500 ? 1 : p < 999 ? -1 : 7;
+    }
+
+    for (const std::size_t n : {1, 1000, 200000}) {
+        const std::span<int const> level(values.data(), n);
+        std::int64_t sum = 0;
+        mpz_class product = 1;
+        std::uint64_t product_mod = 1;
+        constexpr std::uint64_t modulus = 1'000'000'007;
+        for (const auto v : level) {
+            sum += v;
+            product *= v;
+            product_mod = product_mod * static_cast<std::uint64_t>((v % static_cast<std::int64_t>(modulus) + modulus) % modulus) % modulus;
+        }
+
+        const std::map<std::string, std::string> expected{
+            {"sum", std::to_string(sum)},
+            {"min", std::to_string(*std::min_element(level.begin(), level.end()))},
+            {"max", std::to_string(*std::max_element(level.begin(), level.end()))},
+            {"product", detail::format_big(product)},
+            {"mod:1000000007", std::to_string(product_mod)},
+        };
+        for (auto const & [name, value] : expected) {
+            for (const auto w : worker_counts) {
+                const auto got = reduce_level(persistent_pool(w), parse_aggregate(name), n, [&](std::size_t i) { return level[i]; });
+                expect(got == value, fmt::format("{} of {} values with {} workers: {} instead of {}", name, n, w, got, value));
+            }
+        }
+    }
+}
+
+void test_level_bfs()
+{
+    // Random graph with a few isolated vertices, so not everything is reachable
+    constexpr std::uint32_t n = 5000;
+    std::mt19937_64 rng(14);
+    std::uniform_int_distribution<std::uint32_t> vertex(0, n - 20);
+    std::vector<edge> edges;
+    for (std::size_t e = 0; e < 3 * n; ++e) {
+        edges.emplace_back(vertex(rng), vertex(rng));
+    }
+    const auto graph = make_csr(random_ints(n, -9, 9, 15), edges);
+
+    std::vector<std::vector<std::uint32_t>> expected;
+    std::vector<bool> seen(n);
+    std::vector<std::uint32_t> frontier{0};
+    seen[0] = true;
+    while (!frontier.empty()) {
+        std::vector<std::uint32_t> next;
+        for (const auto v : frontier) {
+            for (const auto u : graph.neighbours(v)) {
+                if (!seen[u]) {
+                    seen[u] = true;
+                    next.push_back(u);
+                }
+            }
+        }
+        std::sort(frontier.begin(), frontier.end());
+        expected.push_back(std::move(frontier));
+        frontier = std::move(next);
+    }
+
+    for (const auto w : worker_counts) {
+        std::vector<std::vector<std::uint32_t>> levels;
+        level_bfs(persistent_pool(w), graph, 0, [&](std::size_t level, std::span<std::uint32_t const> f) {
+            expect(level == levels.size(), "level_bfs levels out of order");
+            auto & sorted = levels.emplace_back(f.begin(), f.end());
+            std::sort(sorted.begin(), sorted.end());
+        });
+        expect(levels == expected, fmt::format("level_bfs workers={}", w));
+    }
+    expect_throws([&] { level_bfs(persistent_pool(2), graph, n, [](std::size_t, std::span<std::uint32_t const>) {}); }, "level_bfs from a missing source");
+}
+
+// Fibonacci
+
+mpz_class reference_fib(std::size_t n)
+{
+    mpz_class f;
+    mpz_fib_ui(f.get_mpz_t(), n);
+    return f;
+}
+
+mpz_class random_number(gmp_randclass & rng, std::size_t limbs)
+{
+    return rng.get_z_bits(limbs * GMP_NUMB_BITS);
+}
+
+void test_parallel_multiply()
+{
+    gmp_randclass rng(gmp_randinit_default);
+    rng.seed(16);
+    const auto a = random_number(rng, 3 * toom_threshold_limbs);
+    const mpz_class b = -random_number(rng, toom_threshold_limbs + 17);
+    const auto small = random_number(rng, 10);
+
+    for (const auto w : worker_counts) {
+        mpz_class ab, aa, bb, as;
+        parallel_multiply(persistent_pool(w), {{&a, &b, &ab}, {&a, &a, &aa}, {&b, &b, &bb}, {&a, &small, &as}});
+        expect(ab == a * b && aa == a * a && bb == b * b && as == a * small, fmt::format("parallel_multiply workers={}", w));
+    }
+}
+
+void test_fib()
+{
+    for (const std::size_t n : {0, 1, 2, 3, 10, 93, 1000, 123457}) {
+        for (const auto w : worker_counts) {
+            expect(fib(n, w) == reference_fib(n), fmt::format("fib({}) workers={}", n, w));
+        }
+    }
+    // Big enough for the top squarings to go through the Toom split
+    expect(fib(2'000'000, 4) == reference_fib(2'000'000), "fib(2000000)");
+}
+
+void test_fib_batch()
+{
+    const std::vector<std::size_t> queries{1000, 5, 0, 1000, 77777, 1, 78000, 300000, 6, 5};
+    auto expected = queries;
+    std::sort(expected.begin(), expected.end());
+    expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+
+    for (const auto w : worker_counts) {
+        const auto results = fib_batch(queries, w);
+        expect(results.size() == expected.size(), fmt::format("fib_batch workers={}: {} results", w, results.size()));
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            expect(results[i].first == expected[i] && results[i].second == reference_fib(expected[i]), fmt::format("fib_batch workers={}: F({})", w, expected[i]));
+        }
+    }
+}
+
+void test_to_decimal()
+{
+    gmp_randclass rng(gmp_randinit_default);
+    rng.seed(17);
+    // One with zero runs, so the zero padding between leaves is exercised
+    mpz_class padded;
+    mpz_ui_pow_ui(padded.get_mpz_t(), 10, 200000);
+    padded += 7;
+    for (const mpz_class & x : {mpz_class{0}, mpz_class{-12345}, random_number(rng, 30000), mpz_class(-random_number(rng, 50000)), padded}) {
+        for (const auto w : worker_counts) {
+            expect(to_decimal(persistent_pool(w), x) == x.get_str(), fmt::format("to_decimal of {} digits, workers={}", mpz_sizeinbase(x.get_mpz_t(), 10), w));
+        }
+    }
+}
+
+struct test_case
+{
+    std::string lab;
+    std::string name;
+    std::function<void()> run;
+};
+
+std::vector<test_case> make_tests()
+{
+    return {
+        {"cannon", "block_gemm<int>", test_block_gemm<int>},
+        {"cannon", "block_gemm<int64>", test_block_gemm<std::int64_t>},
+        {"cannon", "block_gemm<float>", test_block_gemm<float>},
+        {"cannon", "block_gemm<double>", test_block_gemm<double>},
+        {"cannon", "cannon_multiply<int>", test_cannon_multiply<int>},
+        {"cannon", "cannon_multiply<double>", test_cannon_multiply<double>},
+        {"monte-carlo", "philox", test_philox},
+        {"monte-carlo", "monte_carlo_pi", test_monte_carlo_pi},
+        {"monte-carlo", "streaming", test_monte_carlo_stream},
+        {"merge", "merge_sort", test_merge_sort},
+        {"merge", "external_sort", test_external_sort},
+        {"max", "parse_int_file", test_int_parser},
+        {"max", "maximum and stream_stats", test_max},
+        {"wc", "histograms", test_wc},
+        {"wc", "incremental index", test_wc_index},
+        {"bfs", "load_tree", test_load_tree},
+        {"bfs", "level aggregates", test_level_aggregates},
+        {"bfs", "level_bfs", test_level_bfs},
+        {"fib", "parallel_multiply", test_parallel_multiply},
+        {"fib", "fib", test_fib},
+        {"fib", "fib_batch", test_fib_batch},
+        {"fib", "to_decimal", test_to_decimal},
+    };
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const std::string_view lab = argc > 1 ? argv[1] : "";
+    const auto tests = make_tests();
+    if (!lab.empty() && std::none_of(tests.begin(), tests.end(), [&](test_case const & t) { return t.lab == lab; })) {
+        spdlog::error("unknown lab: {}", lab);
+        return 1;
+    }
+
+    // The labs log progress, timings and recoverable problems the cases provoke on purpose
+    spdlog::set_level(spdlog::level::err);
+
+    std::size_t n_failed = 0;
+    for (auto const & t : tests) {
+        if (!lab.empty() && t.lab != lab) {
+            continue;
+        }
+        try {
+            t.run();
+            fmt::print("ok     {} / {}\n", t.lab, t.name);
+        }
+        catch (std::exception const & e) {
+            fmt::print("FAILED {} / {}: {}\n", t.lab, t.name, e.what());
+            ++n_failed;
+        }
+        std::fflush(stdout);
+    }
+    return n_failed == 0 ? 0 : 1;
+}
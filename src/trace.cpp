@@ -0,0 +1,227 @@
+#include <trace.hpp>
+
+#ifdef LABS_TRACE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace trace {
+
+namespace {
+
+constexpr std::array<char const *, n_counters> counter_names = {"tasks", "bytes", "elements"};
+
+struct event
+{
+    char const * name;
+    std::uint64_t start_ns;
+    std::uint64_t finish_ns;
+    std::int64_t arg;
+};
+
+// Written only by its own thread; written is published with release so an exporter running after the
+// workers went idle sees complete events
+struct ring
+{
+    std::size_t tid;
+    std::vector<event> events; // grows up to ring_capacity, then wraps
+    std::atomic<std::uint64_t> written{0};
+    std::array<std::atomic<std::uint64_t>, n_counters> counters{};
+
+    // Oldest to newest
+    template <typename F>
+    void for_each(F && f) const
+    {
+        const auto n = written.load(std::memory_order_acquire);
+        const auto kept = std::min<std::uint64_t>(n, ring_capacity);
+        for (auto i = n - kept; i < n; ++i) {
+            f(events[i % ring_capacity]);
+        }
+    }
+
+    std::uint64_t dropped() const
+    {
+        const auto n = written.load(std::memory_order_acquire);
+        return n > ring_capacity ? n - ring_capacity : 0;
+    }
+};
+
+// Rings are shared with the registry, so events of threads that already exited (merge and max spawn
+// threads per call) are still exported. Never destroyed: pool threads may record during static destruction.
+struct registry
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ring>> rings;
+    std::uint64_t epoch_ns = now_ns();
+};
+
+registry & get_registry()
+{
+    static auto * r = new registry;
+    return *r;
+}
+
+ring & local_ring()
+{
+    thread_local std::shared_ptr<ring> r = [] {
+        auto & reg = get_registry();
+        std::lock_guard lock{reg.mutex};
+        auto res = std::make_shared<ring>();
+        res->tid = reg.rings.size();
+        reg.rings.push_back(res);
+        return res;
+    }();
+    return *r;
+}
+
+struct phase_totals
+{
+    std::uint64_t calls = 0;
+    std::uint64_t total_ns = 0;
+    std::uint64_t max_ns = 0;
+};
+
+} // namespace
+
+std::uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(char const * name, std::uint64_t start_ns, std::uint64_t finish_ns, std::int64_t arg)
+{
+    auto & r = local_ring();
+    const auto n = r.written.load(std::memory_order_relaxed);
+    const event e{name, start_ns, finish_ns, arg};
+    if (n < ring_capacity) {
+        r.events.push_back(e);
+    }
+    else {
+        r.events[n % ring_capacity] = e;
+    }
+    r.written.store(n + 1, std::memory_order_release);
+}
+
+void count(counter c, std::uint64_t n)
+{
+    local_ring().counters[static_cast<std::size_t>(c)].fetch_add(n, std::memory_order_relaxed);
+}
+
+void write_chrome_trace(std::string const & path)
+{
+    auto & reg = get_registry();
+    std::lock_guard lock{reg.mutex};
+
+    std::string out = "{\"traceEvents\":[\n";
+    auto us = [&](std::uint64_t ns) { return static_cast<double>(ns - std::min(ns, reg.epoch_ns)) / 1000.0; };
+
+    std::uint64_t last_ns = reg.epoch_ns;
+    std::uint64_t dropped = 0;
+    std::array<std::uint64_t, n_counters> totals{};
+    bool first = true;
+    auto separator = [&] { out += first ? "" : ",\n"; first = false; };
+
+    for (auto const & r : reg.rings) {
+        separator();
+        fmt::format_to(std::back_inserter(out),
+            R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})",
+            r->tid, r->tid == 0 ? "main" : fmt::format("worker {}", r->tid));
+
+        r->for_each([&](event const & e) {
+            separator();
+            fmt::format_to(std::back_inserter(out),
+                R"({{"name":"{}","cat":"labs","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f})",
+                e.name, r->tid, us(e.start_ns), static_cast<double>(e.finish_ns - e.start_ns) / 1000.0);
+            if (e.arg != scope::no_arg) {
+                fmt::format_to(std::back_inserter(out), R"(,"args":{{"arg":{}}})", e.arg);
+            }
+            out += '}';
+            last_ns = std::max(last_ns, e.finish_ns);
+        });
+
+        dropped += r->dropped();
+        for (std::size_t c = 0; c < n_counters; ++c) {
+            totals[c] += r->counters[c].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Counters are totals, shown as one sample at the end of the trace
+    for (std::size_t c = 0; c < n_counters; ++c) {
+        separator();
+        fmt::format_to(std::back_inserter(out), R"({{"name":"{0}","ph":"C","pid":1,"tid":0,"ts":{1:.3f},"args":{{"{0}":{2}}}}})",
+            counter_names[c], us(last_ns), totals[c]);
+    }
+    fmt::format_to(std::back_inserter(out), "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{{\"dropped_events\":{}}}}}\n", dropped);
+
+    std::ofstream file{path, std::ios::binary};
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    if (!file) {
+        throw std::runtime_error(fmt::format("failed to write {}", path));
+    }
+}
+
+void log_summary()
+{
+    auto & reg = get_registry();
+    std::lock_guard lock{reg.mutex};
+
+    std::map<std::string_view, phase_totals> phases;
+    std::array<std::uint64_t, n_counters> totals{};
+    std::uint64_t dropped = 0;
+    for (auto const & r : reg.rings) {
+        r->for_each([&](event const & e) {
+            auto & p = phases[e.name];
+            const auto ns = e.finish_ns - e.start_ns;
+            ++p.calls;
+            p.total_ns += ns;
+            p.max_ns = std::max(p.max_ns, ns);
+        });
+        dropped += r->dropped();
+        for (std::size_t c = 0; c < n_counters; ++c) {
+            totals[c] += r->counters[c].load(std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<std::pair<std::string_view, phase_totals>> sorted(phases.begin(), phases.end());
+    std::sort(sorted.begin(), sorted.end(), [](auto const & lhs, auto const & rhs) { return lhs.second.total_ns > rhs.second.total_ns; });
+    for (auto const & [name, p] : sorted) {
+        spdlog::info("trace {}: {} calls, {:.3f}ms total, {:.3f}ms max", name, p.calls, p.total_ns / 1e6, p.max_ns / 1e6);
+    }
+    spdlog::info("trace counters: {} tasks, {} bytes, {} elements ({} threads, {} events dropped)",
+        totals[0], totals[1], totals[2], reg.rings.size(), dropped);
+}
+
+session::session(std::string const & program)
+{
+    local_ring(); // the main thread gets tid 0
+    const char * env = std::getenv("LABS_TRACE_FILE");
+    path_ = env != nullptr && *env != '\0' ? env : fmt::format("{}.trace.json", program);
+}
+
+session::~session()
+{
+    try {
+        log_summary();
+        write_chrome_trace(path_);
+        spdlog::info("trace written to {}", path_);
+    }
+    catch (std::exception const & e) {
+        spdlog::error("trace: {}", e.what());
+    }
+}
+
+} // namespace trace
+
+#endif
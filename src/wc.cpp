@@ -5,89 +5,761 @@
 #include <span>
 #include <algorithm>
 #include <filesystem>
-#include <map>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
 
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/std.h>
 
-#include <BS_thread_pool.hpp>
+#include <mapped_file.hpp>
+#include <thread_pool.hpp>
+#include <trace.hpp>
+#include <wc.hpp>
+#include <word_table.hpp>
 
-#include <range/v3/view/split_when.hpp>
-#include <range/v3/view/filter.hpp>
-#include <range/v3/view/common.hpp>
-#include <range/v3/view/transform.hpp>
-
-#include <range/v3/range/conversion.hpp>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WC_SSE2 1
+#include <emmintrin.h>
+#endif
 
 namespace fs = std::filesystem;
-namespace rg = ranges;
-namespace vw = ranges::views;
 
-using word_map = std::unordered_map<std::string, std::size_t>;
-using word_list = std::vector<std::tuple<std::string, std::size_t>>;
+bool is_word_delim(char c)
+{
+    return c == ',' || c == ' ';
+}
 
-struct word_histogram
+// Bit i set if p[i] is a delimiter, 64 bytes per call
+std::uint64_t delim_mask(char const * p)
 {
-    fs::path file;
-    word_list map;
-};
+#ifdef WC_SSE2
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i space = _mm_set1_epi8(' ');
+    std::uint64_t mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + 16 * i));
+        const __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, comma), _mm_cmpeq_epi8(chunk, space));
+        mask |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(hits))) << (16 * i);
+    }
+    return mask;
+#else
+    std::uint64_t mask = 0;
+    for (int i = 0; i < 64; ++i) {
+        mask |= static_cast<std::uint64_t>(is_word_delim(p[i])) << i;
+    }
+    return mask;
+#endif
+}
+
+// Call f(word) for every non-empty word of text. Delimiters are found 64 bytes at a time: word starts
+// are the non-delimiter bits preceded by a delimiter, word ends the delimiter bits preceded by a
+// non-delimiter, so the loop only touches word boundaries, never individual characters.
+template <typename F>
+void for_each_word(std::string_view text, F && f)
+{
+    char const * data = text.data();
+    const auto n = text.size();
+
+    std::size_t word_start = 0;
+    bool in_word = false; // whether the byte before the current block is part of a word
+    std::size_t base = 0;
+    for (; base + 64 <= n; base += 64) {
+        const auto delims = delim_mask(data + base);
+        const auto words = ~delims;
+        const auto prev_words = (words << 1) | (in_word ? 1 : 0);
+        auto boundaries = (words & ~prev_words) | (delims & prev_words);
+        while (boundaries != 0) {
+            const auto i = static_cast<std::size_t>(std::countr_zero(boundaries));
+            if (in_word) {
+                f(text.substr(word_start, base + i - word_start));
+            }
+            else {
+                word_start = base + i;
+            }
+            in_word = !in_word;
+            boundaries &= boundaries - 1;
+        }
+    }
+    for (; base < n; ++base) {
+        const bool delim = is_word_delim(data[base]);
+        if (in_word && delim) {
+            f(text.substr(word_start, base - word_start));
+        }
+        else if (!in_word && !delim) {
+            word_start = base;
+        }
+        in_word = !delim;
+    }
+    if (in_word) {
+        f(text.substr(word_start));
+    }
+}
+
+void count_words(std::string_view text, word_table & table)
+{
+    LABS_TRACE_SCOPE("tokenize");
+    LABS_TRACE_COUNT(bytes, text.size());
+    for_each_word(text, [&](std::string_view word) { table.add(word); });
+}
 
-std::vector<word_histogram> folder_word_histogram(fs::path const & path, std::size_t n_workers)
+// Order the histogram's list by count, most frequent first, ties by word, and copy its words into the
+// histogram's arena. With top_k != 0 only the first top_k entries are selected and sorted (partial_sort),
+// the rest is dropped.
+void sort_histogram(word_histogram & h, std::size_t top_k)
 {
-    BS::thread_pool pool(n_workers);
+    LABS_TRACE_SCOPE("sort");
+    LABS_TRACE_COUNT(elements, h.map.size());
+    auto by_count = [](auto const & lhs, auto const & rhs) {
+        auto const & [w1, c1] = lhs;
+        auto const & [w2, c2] = rhs;
+        return c1 != c2 ? c1 > c2 : w1 < w2;
+    };
+    if (top_k != 0 && top_k < h.map.size()) {
+        std::partial_sort(h.map.begin(), h.map.begin() + top_k, h.map.end(), by_count);
+        h.map.resize(top_k);
+    }
+    else {
+        std::sort(h.map.begin(), h.map.end(), by_count);
+    }
 
-    std::vector<std::future<word_histogram>> results;
+    for (auto & [word, count] : h.map) {
+        word = h.arena->intern(word);
+    }
+}
+
+// Every distinct word of the tables into the histogram, sorted; the tables must hold disjoint words
+void finish_histogram(word_histogram & h, std::span<word_table const> tables, std::size_t top_k)
+{
+    std::size_t total = 0;
+    for (auto const & table : tables) {
+        total += table.size();
+    }
+    h.map.reserve(total);
+    for (auto const & table : tables) {
+        table.for_each([&](word_table::entry const & e) {
+            h.map.emplace_back(e.word, e.count);
+        });
+    }
+    sort_histogram(h, top_k);
+}
+
+word_histogram file_word_histogram(fs::path const & path, std::size_t top_k)
+{
+    // Mapping is lazy: page faults of the first touch are part of tokenize
+    auto file = [&] {
+        LABS_TRACE_SCOPE("read");
+        mapped_file f{path};
+        f.advise_sequential();
+        return f;
+    }();
+
+    word_table table;
+    count_words(file.text(), table);
+
+    word_histogram h{path};
+    finish_histogram(h, {&table, 1}, top_k);
+    return h;
+}
+
+std::vector<word_histogram> folder_word_histogram(fs::path const & path, std::size_t n_workers, std::size_t top_k)
+{
+    auto & pool = persistent_pool(n_workers);
+
+    std::vector<task_future<word_histogram>> results;
     for (auto const & dir : fs::directory_iterator(path)) {
+        if (!dir.is_regular_file()) {
+            continue;
+        }
         results.emplace_back(pool.submit_task([=]{
-            std::ifstream file{dir.path()};
-            std::string data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
-            auto words = data
-                | vw::split_when([](char c) { return c == ',' || c == ' '; })
-                | vw::filter([](auto const & word){ return !word.empty(); });
-            
-            word_map map;
-            for (auto && word : words) {
-                auto w = word | vw::common;
-                map[std::string(w.begin(), w.end())] += 1;
+            return file_word_histogram(dir.path(), top_k);
+        }));
+    }
+    LABS_TRACE_COUNT(tasks, results.size());
+
+    std::vector<word_histogram> hists;
+    for (auto & f : results) {
+        hists.push_back(f.get());
+    }
+    return hists;
+}
+
+// Pieces of about chunk_bytes, each extended to the next delimiter so no word straddles two pieces
+std::vector<std::string_view> split_at_delims(std::string_view text, std::size_t chunk_bytes)
+{
+    std::vector<std::string_view> pieces;
+    std::size_t begin = 0;
+    while (begin < text.size()) {
+        auto end = std::min(begin + chunk_bytes, text.size());
+        while (end < text.size() && !is_word_delim(text[end])) ++end;
+        pieces.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+    return pieces;
+}
+
+// Corpus-wide histogram: every file is mapped and cut into pieces, so a single huge file is spread over
+// all workers. Each worker counts the pieces it pulls into its own word_table (keys point into the
+// mappings), then buckets its entries by hash; shard s merges bucket s of every worker in parallel.
+word_histogram corpus_word_histogram(fs::path const & path, std::size_t n_workers, std::size_t top_k)
+{
+    constexpr std::size_t chunk_bytes = 4 << 20;
+
+    std::vector<mapped_file> files;
+    std::vector<std::string_view> pieces;
+    {
+        LABS_TRACE_SCOPE("read");
+        for (auto const & dir : fs::directory_iterator(path)) {
+            if (!dir.is_regular_file()) {
+                continue;
+            }
+            auto const & file = files.emplace_back(dir.path());
+            file.advise_sequential();
+            for (auto piece : split_at_delims(file.text(), chunk_bytes)) {
+                pieces.push_back(piece);
             }
+        }
+    }
 
-            word_list wl(map.cbegin(), map.cend());
-            std::sort(wl.begin(), wl.end(), [](auto const & lhs, auto const & rhs) {
-                auto const & [w1, c1] = lhs;
-                auto const & [w2, c2] = rhs;
-                return c1 != c2 ? c1 > c2 : w1 < w2;
-            });
+    // Sized by the pool's own thread count, so a requested count of 0 still gets workers and shards
+    auto & pool = persistent_pool(n_workers);
+    n_workers = pool.get_thread_count();
+    const auto n_shards = n_workers;
 
-            return word_histogram{dir.path(), wl};
-        }));
+    using bucket = std::vector<word_table::entry>;
+    std::vector<std::vector<bucket>> buckets(n_workers, std::vector<bucket>(n_shards));
+    std::atomic<std::size_t> next_piece{0};
+
+    // The blocks are waited for before get() rethrows a failure: they all write into buckets
+    auto counted = pool.submit_loop<std::size_t>(0, n_workers, [&](std::size_t w) {
+        word_table local;
+        for (auto i = next_piece.fetch_add(1); i < pieces.size(); i = next_piece.fetch_add(1)) {
+            count_words(pieces[i], local);
+        }
+        LABS_TRACE_SCOPE("bucket");
+        local.for_each([&](word_table::entry const & e) {
+            buckets[w][(e.hash >> 32) % n_shards].push_back(e);
+        });
+    }, n_workers);
+    counted.wait();
+    counted.get();
+    LABS_TRACE_COUNT(tasks, n_workers);
+
+    std::vector<word_table> shards(n_shards);
+    auto merged_shards = pool.submit_loop<std::size_t>(0, n_shards, [&](std::size_t s) {
+        LABS_TRACE_SCOPE_ARG("merge", s);
+        std::size_t expected = 0;
+        for (auto const & b : buckets) {
+            expected += b[s].size();
+        }
+        shards[s] = word_table(expected);
+        for (auto const & b : buckets) {
+            for (auto const & e : b[s]) {
+                shards[s].add(e.word, e.hash, e.count);
+            }
+        }
+    }, n_shards);
+    merged_shards.wait();
+    merged_shards.get();
+    LABS_TRACE_COUNT(tasks, n_shards);
+
+    // Shards hold disjoint words, so their entries go straight into the histogram
+    word_histogram h{path};
+    finish_histogram(h, shards, top_k);
+    return h;
+}
+
+// Persistent index for incremental runs: the full histogram of every file seen so far, keyed by path
+// and valid while the file keeps its size and mtime, and the corpus counts of all of them. The index is
+// a log: a run that sees changes appends one batch with the records of new and changed files, the
+// deleted paths and the net change of the corpus counts, so it writes only what changed. Binary layout,
+// native byte order:
+//   "WCIX" u32 version, then batches of
+//   u64 n_bytes of the rest of the batch, u64 n_files,
+//   per file: u32 path length, path, u64 size, i64 mtime, histogram
+//   u64 n_deleted, per deleted file: u32 path length, path
+//   corpus delta
+// where a histogram is u64 n_words, u64 n_bytes and n_bytes of n_words x (u32 length, word, u64 count)
+// in histogram order, and the corpus delta is laid out the same with i64 changes of count, unordered.
+// Later batches override earlier ones and the corpus counts are the sum of all deltas; a batch cut short
+// by an interrupted append is dropped. The byte lengths let a run skip every histogram it doesn't need,
+// so loading the index only reads the per-file headers.
+struct encoded_histogram
+{
+    std::uint64_t n_words = 0;
+    std::string_view bytes;
+};
+
+struct index_entry
+{
+    std::uint64_t size;
+    std::int64_t mtime;
+    encoded_histogram hist;
+    std::size_t record_bytes = 0; // of its file record in the log
+};
+
+struct wc_index
+{
+    std::optional<mapped_file> file; // the encoded histograms point into it
+    std::unordered_map<std::string, index_entry> files;
+    std::vector<encoded_histogram> corpus_deltas; // one per batch, in log order
+    std::size_t valid_bytes = 0; // the header and every complete batch
+    std::size_t live_bytes = 0;  // file records of files, the rest of the log is superseded
+};
+
+constexpr char index_magic[4] = {'W', 'C', 'I', 'X'};
+constexpr std::uint32_t index_version = 3;
+
+// Bounds-checked sequential reader over the mapped index
+class index_reader
+{
+public:
+    explicit index_reader(std::string_view data) : data_{data} {}
+
+    template <typename T>
+    T read()
+    {
+        T value;
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view read_string()
+    {
+        return take(read<std::uint32_t>());
+    }
+
+    encoded_histogram read_histogram()
+    {
+        const auto n_words = read<std::uint64_t>();
+        return {n_words, take(read<std::uint64_t>())};
+    }
+
+    std::string_view take(std::size_t n)
+    {
+        if (n > data_.size()) {
+            throw std::runtime_error("truncated index");
+        }
+        const auto res = data_.substr(0, n);
+        data_.remove_prefix(n);
+        return res;
+    }
+
+    std::size_t remaining() const { return data_.size(); }
+
+private:
+    std::string_view data_;
+};
+
+// First limit words of an encoded histogram (all of them for 0), interned into arena
+word_list decode_histogram(encoded_histogram const & hist, word_arena & arena, std::size_t limit)
+{
+    const auto n = limit != 0 ? std::min<std::uint64_t>(hist.n_words, limit) : hist.n_words;
+    index_reader in{hist.bytes};
+    word_list res;
+    res.reserve(n);
+    for (std::uint64_t w = 0; w < n; ++w) {
+        const auto word = arena.intern(in.read_string());
+        res.emplace_back(word, in.read<std::uint64_t>());
+    }
+    return res;
+}
+
+// Entries of a (word, count) list as Count, the layout of histograms and corpus deltas
+template <typename Count, typename List>
+std::string encode_counts(List const & list)
+{
+    std::string out;
+    auto put = [&](auto value) { out.append(reinterpret_cast<char const *>(&value), sizeof(value)); };
+    for (auto const & [word, count] : list) {
+        put(static_cast<std::uint32_t>(word.size()));
+        out.append(word);
+        put(static_cast<Count>(count));
+    }
+    return out;
+}
+
+// Missing or unreadable indexes are treated as empty, so the run falls back to a full recount
+wc_index load_index(fs::path const & path)
+{
+    LABS_TRACE_SCOPE("load_index");
+    wc_index index;
+    if (!fs::exists(path)) {
+        return index;
     }
 
-    return results
-        | vw::transform([](auto && f) { return f.get(); })
-        | rg::to<std::vector>();
+    try {
+        index.file.emplace(path);
+        const auto text = index.file->text();
+        index_reader in{text};
+        if (in.take(sizeof(index_magic)) != std::string_view{index_magic, sizeof(index_magic)} || in.read<std::uint32_t>() != index_version) {
+            throw std::runtime_error("not a wc index");
+        }
+        index.valid_bytes = text.size() - in.remaining();
+
+        while (in.remaining() >= sizeof(std::uint64_t)) {
+            const auto n_bytes = in.read<std::uint64_t>();
+            if (n_bytes > in.remaining()) {
+                break; // torn append, the next one overwrites it
+            }
+            index_reader batch{in.take(n_bytes)};
+
+            const auto n_files = batch.read<std::uint64_t>();
+            for (std::uint64_t f = 0; f < n_files; ++f) {
+                const auto record_start = batch.remaining();
+                auto file_path = std::string(batch.read_string());
+                const auto size = batch.read<std::uint64_t>();
+                const auto mtime = batch.read<std::int64_t>();
+                const index_entry entry{size, mtime, batch.read_histogram(), record_start - batch.remaining()};
+
+                const auto [it, inserted] = index.files.try_emplace(std::move(file_path), entry);
+                if (!inserted) {
+                    index.live_bytes -= it->second.record_bytes;
+                    it->second = entry;
+                }
+                index.live_bytes += entry.record_bytes;
+            }
+
+            const auto n_deleted = batch.read<std::uint64_t>();
+            for (std::uint64_t f = 0; f < n_deleted; ++f) {
+                const auto it = index.files.find(std::string(batch.read_string()));
+                if (it != index.files.end()) {
+                    index.live_bytes -= it->second.record_bytes;
+                    index.files.erase(it);
+                }
+            }
+
+            index.corpus_deltas.push_back(batch.read_histogram());
+            index.valid_bytes = text.size() - in.remaining();
+        }
+    }
+    catch (std::exception const & e) {
+        spdlog::warn("ignoring index {}: {}", path, e.what());
+        index = {};
+    }
+    return index;
 }
 
-int main(int argc, char** argv)
+// Signed corpus counts while deltas are summed; words that drop to zero are erased
+using corpus_counts = std::unordered_map<std::string_view, std::int64_t>;
+using corpus_delta = std::vector<std::pair<std::string_view, std::int64_t>>;
+
+void apply_delta(corpus_counts & counts, std::string_view word, std::int64_t delta)
 {
-    const std::string path = argv[1];
-    const std::size_t n_workers = std::stoull(argv[2]);
+    const auto it = counts.try_emplace(word, 0).first;
+    if ((it->second += delta) == 0) {
+        counts.erase(it);
+    }
+}
 
-    const auto start = std::chrono::high_resolution_clock::now();
+// Corpus counts of the index, the sum of the deltas of all batches; the words point into the mapped index
+corpus_counts sum_corpus(wc_index const & index)
+{
+    corpus_counts counts;
+    if (!index.corpus_deltas.empty()) {
+        counts.reserve(index.corpus_deltas.front().n_words);
+    }
+    for (auto const & d : index.corpus_deltas) {
+        index_reader in{d.bytes};
+        for (std::uint64_t w = 0; w < d.n_words; ++w) {
+            const auto word = in.read_string();
+            apply_delta(counts, word, in.read<std::int64_t>());
+        }
+    }
+    return counts;
+}
+
+// Net change of the corpus counts from the removed (stale) to the added (fresh) histograms,
+// words whose count doesn't change are left out
+corpus_delta diff_counts(word_table const & added, word_table const & removed)
+{
+    corpus_delta delta;
+    added.for_each([&](word_table::entry const & e) {
+        const auto d = static_cast<std::int64_t>(e.count) - static_cast<std::int64_t>(removed.count(e.word));
+        if (d != 0) {
+            delta.emplace_back(e.word, d);
+        }
+    });
+    removed.for_each([&](word_table::entry const & e) {
+        if (added.count(e.word) == 0) {
+            delta.emplace_back(e.word, -static_cast<std::int64_t>(e.count));
+        }
+    });
+    return delta;
+}
 
-    auto hists = folder_word_histogram(path, n_workers);
+struct index_record
+{
+    std::string_view path;
+    std::uint64_t size;
+    std::int64_t mtime;
+    encoded_histogram hist;
+};
+
+// One batch of the log, prefixed by its byte length
+std::string encode_batch(std::vector<index_record> const & records, std::vector<std::string_view> const & deleted, encoded_histogram const & delta)
+{
+    std::string out;
+    auto put = [&](auto value) { out.append(reinterpret_cast<char const *>(&value), sizeof(value)); };
+    auto put_string = [&](std::string_view s) { put(static_cast<std::uint32_t>(s.size())); out.append(s); };
+    auto put_histogram = [&](encoded_histogram const & h) { put(h.n_words); put(static_cast<std::uint64_t>(h.bytes.size())); out.append(h.bytes); };
 
-    const auto finish = std::chrono::high_resolution_clock::now();
-    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+    put(std::uint64_t{0}); // n_bytes, patched below
+    put(static_cast<std::uint64_t>(records.size()));
+    for (auto const & r : records) {
+        put_string(r.path);
+        put(r.size);
+        put(r.mtime);
+        put_histogram(r.hist);
+    }
+    put(static_cast<std::uint64_t>(deleted.size()));
+    for (auto const & path : deleted) {
+        put_string(path);
+    }
+    put_histogram(delta);
 
-    for (auto & h : hists) {
-        spdlog::info("Word map for {}", h.file);
-        for (auto && entry : h.map) {
-            auto && [k, v] = entry;
-            spdlog::info("{}: {}", k, v);
+    const std::uint64_t n_bytes = out.size() - sizeof(std::uint64_t);
+    std::memcpy(out.data(), &n_bytes, sizeof(n_bytes));
+    return out;
+}
+
+// Append batch after the last complete one, dropping a torn tail first
+void append_index(fs::path const & path, std::size_t valid_bytes, std::string const & batch)
+{
+    LABS_TRACE_SCOPE("save_index");
+    if (fs::file_size(path) != valid_bytes) {
+        fs::resize_file(path, valid_bytes);
+    }
+    std::ofstream file{path, std::ios::binary | std::ios::app};
+    file.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+    if (!file) {
+        throw std::runtime_error(fmt::format("failed to write {}", path.string()));
+    }
+    LABS_TRACE_COUNT(bytes, batch.size());
+}
+
+// Replace the index by a fresh log holding just batch. Written next to the target and renamed over it,
+// so an interrupted run never leaves a torn index.
+void rewrite_index(fs::path const & path, std::string const & batch)
+{
+    LABS_TRACE_SCOPE("save_index");
+    const auto tmp = fs::path(path).concat(".tmp");
+    {
+        std::ofstream file{tmp, std::ios::binary};
+        file.write(index_magic, sizeof(index_magic));
+        file.write(reinterpret_cast<char const *>(&index_version), sizeof(index_version));
+        file.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+        if (!file) {
+            throw std::runtime_error(fmt::format("failed to write {}", tmp.string()));
         }
+        LABS_TRACE_COUNT(bytes, batch.size());
     }
+    fs::rename(tmp, path);
+}
+
+// Files whose size and mtime match the index are taken from it, only new or changed files are read and
+// counted (in parallel). Cached histograms are decoded only as far as the output needs them (the top K
+// words), and the corpus counts only with corpus set. A run with changes decodes the stale histograms of
+// the changed and deleted files, subtracts them from the fresh ones and appends the records and this
+// delta to the index; a run without changes writes nothing. Once superseded records make up two thirds
+// of the log, it is rewritten with only the live records and the summed corpus counts, which takes at
+// least as many appended bytes as the rewrite writes, so it adds O(1) per appended byte.
+std::vector<word_histogram> incremental_histograms(fs::path const & path, std::size_t n_workers, fs::path const & index_path, bool corpus, std::size_t top_k)
+{
+    auto index = load_index(index_path);
+    const bool had_index = index.file.has_value();
 
-    spdlog::info("==================");
-    spdlog::info("elapsed: {}mcs {} workers", elapsed, n_workers);
-    spdlog::info("{} hw cores", std::thread::hardware_concurrency());
+    auto & pool = persistent_pool(n_workers);
+
+    struct pending
+    {
+        std::string key;
+        std::uint64_t size;
+        std::int64_t mtime;
+        task_future<word_histogram> hist;
+    };
+    std::vector<pending> changed;
+
+    // Current files in directory order; unchanged ones move out of index.files, the stale entries of
+    // changed ones into replaced, which leaves index.files with the deleted files
+    struct current
+    {
+        std::string key;
+        std::optional<index_entry> cached;
+        std::size_t changed = 0; // index into changed when not cached
+    };
+    std::vector<current> files;
+    std::vector<index_entry> replaced;
+
+    for (auto const & dir : fs::directory_iterator(path)) {
+        if (!dir.is_regular_file()) {
+            continue;
+        }
+        auto key = dir.path().string();
+        const std::uint64_t size = dir.file_size();
+        const std::int64_t mtime = dir.last_write_time().time_since_epoch().count();
+
+        const auto it = index.files.find(key);
+        if (it != index.files.end() && it->second.size == size && it->second.mtime == mtime) {
+            files.push_back({std::move(key), it->second});
+            index.files.erase(it);
+            continue;
+        }
+        if (it != index.files.end()) {
+            replaced.push_back(it->second);
+            index.files.erase(it);
+        }
+        files.push_back({key, std::nullopt, changed.size()});
+        changed.push_back({std::move(key), size, mtime, pool.submit_task([p = dir.path()]{ return file_word_histogram(p, 0); })});
+    }
+
+    LABS_TRACE_COUNT(tasks, changed.size());
+    std::vector<word_histogram> fresh;
+    fresh.reserve(changed.size());
+    for (auto & c : changed) {
+        fresh.push_back(c.hist.get());
+    }
+
+    const bool up_to_date = had_index && changed.empty() && index.files.empty();
+    spdlog::info("index {}: {} files cached, {} counted, {} deleted{}", index_path, files.size() - changed.size(), changed.size(),
+        index.files.size(), up_to_date ? ", up to date" : "");
+
+    // Change of the corpus counts: fresh histograms in, stale ones (of changed and deleted files) out
+    word_arena scratch;
+    corpus_delta delta;
+    std::size_t stale_bytes = 0;
+    if (!up_to_date) {
+        word_table added;
+        for (auto const & h : fresh) {
+            for (auto const & [word, count] : h.map) {
+                added.add(word, count);
+            }
+        }
+        word_table removed;
+        auto subtract = [&](index_entry const & entry) {
+            stale_bytes += entry.record_bytes;
+            for (auto const & [word, count] : decode_histogram(entry.hist, scratch, 0)) {
+                removed.add(word, count);
+            }
+        };
+        for (auto const & entry : replaced) {
+            subtract(entry);
+        }
+        for (auto const & [key, entry] : index.files) {
+            subtract(entry);
+        }
+        delta = diff_counts(added, removed);
+    }
+
+    std::deque<std::string> encoded; // stable addresses for the views in records
+    auto fresh_record = [&](std::size_t i) {
+        auto const & list = fresh[i].map;
+        return index_record{changed[i].key, changed[i].size, changed[i].mtime, {list.size(), encoded.emplace_back(encode_counts<std::uint64_t>(list))}};
+    };
+    std::vector<index_record> records;
+    records.reserve(changed.size());
+    for (std::size_t i = 0; i < changed.size(); ++i) {
+        records.push_back(fresh_record(i));
+    }
+    std::vector<std::string_view> deleted;
+    for (auto const & [key, entry] : index.files) {
+        deleted.push_back(key);
+    }
+    const auto batch = up_to_date ? std::string{} : encode_batch(records, deleted, {delta.size(), encode_counts<std::int64_t>(delta)});
+
+    std::size_t live_bytes = index.live_bytes - stale_bytes;
+    for (auto const & r : records) {
+        live_bytes += sizeof(std::uint32_t) + r.path.size() + sizeof(r.size) + sizeof(r.mtime) + 2 * sizeof(std::uint64_t) + r.hist.bytes.size();
+    }
+    const bool rewrite = !up_to_date && (!had_index || index.valid_bytes + batch.size() > 3 * live_bytes);
+
+    // Current corpus counts, summed only when the output or a rewrite needs them
+    std::optional<corpus_counts> counts;
+    if (corpus || rewrite) {
+        counts = sum_corpus(index);
+        for (auto const & [word, d] : delta) {
+            apply_delta(*counts, word, d);
+        }
+    }
+
+    std::vector<word_histogram> hists;
+    if (corpus) {
+        word_histogram h{path};
+        h.map.reserve(counts->size());
+        for (auto const & [word, count] : *counts) {
+            h.map.emplace_back(word, static_cast<std::size_t>(count));
+        }
+        sort_histogram(h, top_k);
+        hists.push_back(std::move(h));
+    }
+    else {
+        // Cached histograms are decoded in one contiguous group of files per worker, each into its own arena
+        hists.resize(files.size());
+        const auto n_groups = std::max<std::size_t>(std::min(n_workers, files.size()), 1);
+        run_tasks(pool, n_groups, [&](std::size_t g) {
+            auto arena = std::make_shared<word_arena>();
+            for (auto i = files.size() * g / n_groups; i < files.size() * (g + 1) / n_groups; ++i) {
+                if (files[i].cached) {
+                    hists[i] = word_histogram{files[i].key, decode_histogram(files[i].cached->hist, *arena, top_k), arena};
+                }
+                else {
+                    hists[i] = fresh[files[i].changed];
+                }
+            }
+        });
+    }
+
+    if (rewrite) {
+        // Every live record and the whole corpus as the first delta, in a fresh log
+        std::vector<index_record> live;
+        live.reserve(files.size());
+        for (auto const & f : files) {
+            if (f.cached) {
+                live.push_back({f.key, f.cached->size, f.cached->mtime, f.cached->hist});
+            }
+            else {
+                live.push_back(records[f.changed]);
+            }
+        }
+        const auto log = encode_batch(live, {}, {counts->size(), encode_counts<std::int64_t>(*counts)});
+        // Nothing may point into the old index from here on, and Windows can't replace a mapped file
+        counts.reset();
+        index = {};
+        rewrite_index(index_path, log);
+    }
+    else if (!up_to_date) {
+        const auto valid_bytes = index.valid_bytes;
+        index = {};
+        append_index(index_path, valid_bytes, batch);
+    }
+
+    // Fresh histograms are complete, the top K is their prefix
+    if (top_k != 0) {
+        for (auto & h : hists) {
+            h.map.resize(std::min(h.map.size(), top_k));
+        }
+    }
+    return hists;
+}
+
+// One fwrite instead of a log line per word
+void print_histograms(std::vector<word_histogram> const & hists)
+{
+    std::string out;
+    for (auto const & h : hists) {
+        fmt::format_to(std::back_inserter(out), "Word map for {}\n", h.file.string());
+        for (auto const & [word, count] : h.map) {
+            fmt::format_to(std::back_inserter(out), "{}: {}\n", word, count);
+        }
+    }
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    std::fflush(stdout);
 }
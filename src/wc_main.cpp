@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <exception>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/std.h>
+
+#include <wc.hpp>
+#include <trace.hpp>
+
+namespace fs = std::filesystem;
+
+int main(int argc, char** argv)
+{
+    LABS_TRACE_SESSION("wc");
+    const std::string path = argv[1];
+    const std::size_t n_workers = std::stoull(argv[2]);
+
+    bool corpus = false;
+    std::size_t top_k = 0;
+    std::optional<fs::path> index_path;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--corpus") {
+            corpus = true;
+        }
+        else if (arg == "--top" && i + 1 < argc) {
+            top_k = std::stoull(argv[++i]);
+        }
+        else if (arg == "--index" && i + 1 < argc) {
+            index_path = argv[++i];
+        }
+        else {
+            spdlog::error("unknown argument: {}", arg);
+            return 1;
+        }
+    }
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<word_histogram> hists;
+    try {
+        if (index_path) {
+            hists = incremental_histograms(path, n_workers, *index_path, corpus, top_k);
+        }
+        else {
+            hists = corpus ? std::vector{corpus_word_histogram(path, n_workers, top_k)} : folder_word_histogram(path, n_workers, top_k);
+        }
+    }
+    catch (std::exception const & e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+
+    const auto finish = std::chrono::high_resolution_clock::now();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+
+    print_histograms(hists);
+
+    spdlog::info("==================");
+    spdlog::info("elapsed: {}mcs {} workers", elapsed, n_workers);
+    spdlog::info("{} hw cores", std::thread::hardware_concurrency());
+}
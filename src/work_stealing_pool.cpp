@@ -0,0 +1,350 @@
+#include <work_stealing_pool.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Failed attempts to find work before an idle worker goes to sleep, or a helping wait yields
+constexpr int spin_rounds = 64;
+
+struct worker_context
+{
+    work_stealing_pool const * pool = nullptr;
+    std::size_t index = 0;
+};
+
+thread_local worker_context current;
+
+std::atomic<int> default_placement_override{-1};
+
+#ifdef __linux__
+
+std::vector<int> allowed_cpus()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::vector<int> cpus;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; ++c) {
+            if (CPU_ISSET(c, &set)) {
+                cpus.push_back(c);
+            }
+        }
+    }
+    return cpus;
+}
+
+// "0-3,8-11" style list from sysfs
+std::vector<int> parse_cpu_list(std::string const & text)
+{
+    std::vector<int> cpus;
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        auto end = text.find(',', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const auto item = text.substr(pos, end - pos);
+        const auto dash = item.find('-');
+        if (!item.empty() && item != "\n") {
+            const int first = std::stoi(item.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            for (int c = first; c <= last; ++c) {
+                cpus.push_back(c);
+            }
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+// Allowed CPUs grouped by NUMA node, a single group when the machine reports no nodes
+std::vector<std::vector<int>> numa_nodes(std::vector<int> const & allowed)
+{
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; ++node) {
+        std::ifstream file{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+        if (!file) {
+            break;
+        }
+        std::string text;
+        std::getline(file, text);
+        std::vector<int> cpus;
+        for (const auto c : parse_cpu_list(text)) {
+            if (std::find(allowed.begin(), allowed.end(), c) != allowed.end()) {
+                cpus.push_back(c);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(std::move(cpus));
+        }
+    }
+    if (nodes.empty()) {
+        nodes.push_back(allowed);
+    }
+    return nodes;
+}
+
+// CPU for every worker, -1 to leave it unpinned
+std::vector<int> worker_cpus(placement where, std::size_t n_workers)
+{
+    std::vector<int> res(n_workers, -1);
+    const auto allowed = allowed_cpus();
+    if (where == placement::none || allowed.empty()) {
+        return res;
+    }
+
+    if (where == placement::compact) {
+        for (std::size_t w = 0; w < n_workers; ++w) {
+            res[w] = allowed[w % allowed.size()];
+        }
+        return res;
+    }
+
+    const auto nodes = numa_nodes(allowed);
+    for (std::size_t w = 0; w < n_workers; ++w) {
+        auto const & node = nodes[w % nodes.size()];
+        res[w] = node[(w / nodes.size()) % node.size()];
+    }
+    return res;
+}
+
+void pin_current_thread(int cpu)
+{
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        spdlog::warn("failed to pin a worker to cpu {}", cpu);
+    }
+}
+
+#else
+
+std::vector<int> worker_cpus(placement where, std::size_t n_workers)
+{
+    if (where != placement::none) {
+        spdlog::warn("worker placement {} is not supported on this platform", placement_name(where));
+    }
+    return std::vector<int>(n_workers, -1);
+}
+
+void pin_current_thread(int) {}
+
+#endif
+
+} // namespace
+
+placement parse_placement(std::string_view name)
+{
+    if (name == "none") return placement::none;
+    if (name == "compact") return placement::compact;
+    if (name == "numa") return placement::numa;
+    throw std::invalid_argument("unknown placement: " + std::string(name) + " (none, compact or numa)");
+}
+
+std::string_view placement_name(placement p)
+{
+    switch (p) {
+    case placement::compact: return "compact";
+    case placement::numa: return "numa";
+    default: return "none";
+    }
+}
+
+placement default_placement()
+{
+    const auto override = default_placement_override.load(std::memory_order_relaxed);
+    if (override >= 0) {
+        return static_cast<placement>(override);
+    }
+
+    const char * env = std::getenv("LABS_AFFINITY");
+    if (env == nullptr || *env == '\0') {
+        return placement::none;
+    }
+    try {
+        return parse_placement(env);
+    }
+    catch (std::exception const & e) {
+        spdlog::warn("ignoring LABS_AFFINITY: {}", e.what());
+        return placement::none;
+    }
+}
+
+void set_default_placement(placement p)
+{
+    default_placement_override.store(static_cast<int>(p), std::memory_order_relaxed);
+}
+
+work_stealing_pool::work_stealing_pool(std::size_t n_workers, placement where)
+    : placement_{where}
+{
+    n_workers = std::max<std::size_t>(n_workers, 1);
+    for (std::size_t w = 0; w < n_workers; ++w) {
+        queues_.push_back(std::make_unique<worker_queue>());
+    }
+
+    const auto cpus = worker_cpus(where, n_workers);
+    workers_.reserve(n_workers);
+    for (std::size_t w = 0; w < n_workers; ++w) {
+        workers_.emplace_back([this, w, cpu = cpus[w]] {
+            pin_current_thread(cpu);
+            current = {this, w};
+            worker_loop(w);
+        });
+    }
+}
+
+work_stealing_pool::~work_stealing_pool()
+{
+    {
+        std::lock_guard lock{sleep_mutex_};
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto & t : workers_) {
+        t.join();
+    }
+}
+
+std::size_t work_stealing_pool::current_worker() const
+{
+    return current.pool == this ? current.index : npos;
+}
+
+void work_stealing_pool::push(detail::task t)
+{
+    auto self = current_worker();
+    if (self == npos) {
+        self = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    }
+    {
+        auto & q = *queues_[self];
+        std::lock_guard lock{q.mutex};
+        q.tasks.push_back(std::move(t));
+    }
+
+    // The increment comes before taking sleep_mutex_, so a worker either sees it in its wait predicate
+    // or is already waiting and gets the notification
+    queued_.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard lock{sleep_mutex_};
+    }
+    wake_.notify_one();
+}
+
+detail::task work_stealing_pool::pop(std::size_t self)
+{
+    if (queued_.load(std::memory_order_acquire) == 0) {
+        return nullptr;
+    }
+
+    // Own deque from the back: the most recently forked task, whose data is still in cache
+    {
+        auto & q = *queues_[self];
+        std::lock_guard lock{q.mutex};
+        if (!q.tasks.empty()) {
+            auto t = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return t;
+        }
+    }
+
+    // Victims from the front: the oldest tasks, usually the largest pieces of a fork/join tree
+    for (std::size_t i = 1; i < queues_.size(); ++i) {
+        auto & q = *queues_[(self + i) % queues_.size()];
+        std::unique_lock lock{q.mutex, std::try_to_lock};
+        if (lock.owns_lock() && !q.tasks.empty()) {
+            auto t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+bool work_stealing_pool::run_one(std::size_t self)
+{
+    auto t = pop(self);
+    if (!t) {
+        return false;
+    }
+    t->run();
+    return true;
+}
+
+void work_stealing_pool::worker_loop(std::size_t self)
+{
+    for (;;) {
+        int idle = 0;
+        while (idle < spin_rounds) {
+            idle = run_one(self) ? 0 : idle + 1;
+        }
+
+        std::unique_lock lock{sleep_mutex_};
+        wake_.wait(lock, [&] { return stop_ || queued_.load(std::memory_order_acquire) != 0; });
+        if (stop_ && queued_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+void work_stealing_pool::notify_waiters()
+{
+    // Pairs with the fence in wait_for: either the waiter sees the ready flag or this sees the waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    {
+        std::lock_guard lock{sleep_mutex_};
+    }
+    wake_.notify_all();
+}
+
+void work_stealing_pool::wait_for(std::atomic<bool> const & flag)
+{
+    const auto self = current_worker();
+    if (self == npos) {
+        flag.wait(false, std::memory_order_acquire);
+        return;
+    }
+
+    int idle = 0;
+    while (!flag.load(std::memory_order_acquire)) {
+        if (run_one(self)) {
+            idle = 0;
+            continue;
+        }
+        if (++idle < spin_rounds) {
+            continue;
+        }
+
+        // Nothing to help with: sleep until the result is ready or new tasks arrive, like an idle worker
+        waiting_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock lock{sleep_mutex_};
+            wake_.wait(lock, [&] { return flag.load(std::memory_order_acquire) || queued_.load(std::memory_order_acquire) != 0; });
+        }
+        waiting_.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}